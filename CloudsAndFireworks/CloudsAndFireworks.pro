@@ -1,4 +1,4 @@
-QT       += core gui multimedia
+QT       += core gui multimedia concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -11,14 +11,54 @@ SOURCES += main.cpp\
     window.cpp \
     glmatrixstack.cpp \
     cloud.cpp \
-    firework.cpp
+    firework.cpp \
+    frameprofiler.cpp \
+    tracer.cpp \
+    renderer.cpp \
+    benchmark.cpp \
+    framecapture.cpp \
+    assetpack.cpp \
+    glstatecache.cpp \
+    gpumemorytracker.cpp \
+    rendertargetpool.cpp \
+    resolutionscaler.cpp \
+    gpuparticlesystem.cpp \
+    analyticparticlesystem.cpp \
+    audioengine.cpp \
+    particlebudget.cpp \
+    inputlog.cpp \
+    stresstest.cpp \
+    showfile.cpp \
+    showscheduler.cpp \
+    launchserver.cpp \
+    particleeffect.cpp
 
 HEADERS  += \
     resourcemanager.h \
     window.h \
     glmatrixstack.h \
     cloud.h \
-    firework.h
+    firework.h \
+    frameprofiler.h \
+    tracer.h \
+    renderer.h \
+    benchmark.h \
+    framecapture.h \
+    assetpack.h \
+    glstatecache.h \
+    gpumemorytracker.h \
+    rendertargetpool.h \
+    resolutionscaler.h \
+    gpuparticlesystem.h \
+    analyticparticlesystem.h \
+    audioengine.h \
+    particlebudget.h \
+    inputlog.h \
+    stresstest.h \
+    showfile.h \
+    showscheduler.h \
+    launchserver.h \
+    particleeffect.h
 
 FORMS    +=
 
@@ -27,6 +67,19 @@ RESOURCES += \
 
 QMAKE_CXXFLAGS += -std=c++11
 
+# Trace markers are compiled in for debug builds and for release builds configured with CONFIG+=tracing
+CONFIG(debug, debug|release)|tracing {
+    DEFINES += ENABLE_TRACING
+}
+
+# "make assets" writes assets.pak next to the executable. Build tools/assetpacker first and pass its path
+# to qmake with ASSET_PACKER=..., ASSET_PACK_FLAGS=--bc stores the textures BC1/BC3 compressed
+isEmpty(ASSET_PACKER): ASSET_PACKER = assetpacker
+ASSET_IMAGES = images/background.png images/circleParticle.png images/starParticle.png images/explosion.png
+
+assets.commands = $$ASSET_PACKER $$ASSET_PACK_FLAGS $$shell_quote($$OUT_PWD/assets.pak) $$shell_quote($$PWD) $$ASSET_IMAGES
+QMAKE_EXTRA_TARGETS += assets
+
 QMAKE_LFLAGS += -static -static-libgcc
 
 RC_ICONS = firework.ico
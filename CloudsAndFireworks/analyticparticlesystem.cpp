@@ -0,0 +1,205 @@
+#include "analyticparticlesystem.h"
+#include "tracer.h"
+#include <QOpenGLContext>
+
+AnalyticParticleSystem::AnalyticParticleSystem()
+    : m_resourceManager(NULL)
+    , m_particleProgram(NULL)
+    , m_explosionProgram(NULL)
+    , m_particleBuffer(NULL)
+    , m_explosionBuffer(NULL)
+    , m_trailLength(1)
+    , m_frame(0)
+    , m_liveParticles(0)
+    , m_uploadedParticles(0)
+    , m_uploadedExplosions(0)
+{
+    m_vertexArrays[0] = 0;
+    m_vertexArrays[1] = 0;
+}
+
+AnalyticParticleSystem::~AnalyticParticleSystem()
+{
+    if(m_resourceManager && QOpenGLContext::currentContext())
+        glDeleteVertexArrays(2, m_vertexArrays);
+}
+
+bool AnalyticParticleSystem::init(ResourceManager &resourceManager, FireworkTypes type)
+{
+    if(!initializeOpenGLFunctions())
+        return false;
+
+    m_resourceManager = &resourceManager;
+
+    // The closed form has to match the integration of Firework::moveParticle() step by step
+    QStringList defines;
+    defines << QStringLiteral("GRAVITY %1").arg(Firework::GRAVITY, 0, 'f', 6)
+            << QStringLiteral("DAMPING %1").arg(Firework::DAMPING, 0, 'f', 6)
+            << QStringLiteral("LAUNCH_POSITION_Y %1").arg(Firework::LAUNCH_POSITION_Y, 0, 'f', 6)
+            << QStringLiteral("POINT_SPRITES");
+
+    m_particleProgram = resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/trajectory.vert", ":/shaders/pointsprite.geom",
+                                                            QStringList(defines) << (type == FireworkTypes::Blinks ? "MODE BLINKS" : "MODE SNAKES"));
+    m_explosionProgram = resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/trajectory.vert", ":/shaders/pointsprite.geom",
+                                                             QStringList(defines) << "MODE EXPLOSION" << "SPRITE_FLIPBOOK");
+
+    m_particleBuffer = resourceManager.createVertexBuffer(1024 * sizeof(TrajectoryData), NULL, QOpenGLBuffer::DynamicDraw);
+    m_explosionBuffer = resourceManager.createVertexBuffer(64 * sizeof(TrajectoryData), NULL, QOpenGLBuffer::DynamicDraw);
+
+    glGenVertexArrays(2, m_vertexArrays);
+    setupVertexArray(m_vertexArrays[0], m_particleBuffer);
+    setupVertexArray(m_vertexArrays[1], m_explosionBuffer);
+
+    return true;
+}
+
+void AnalyticParticleSystem::emitBurst(const QVector<TrajectoryData> &particles, const QVector2D &explosionPosition)
+{
+    if(particles.isEmpty())
+        return;
+
+    const TrajectoryData &first = particles.first();
+
+    // The last trail node disappears maxTail frames after the head
+    int endFrame = (int)(first.spawnFrame + first.flightDuration + first.maxTail);
+
+    m_particles << particles;
+    m_explosions << TrajectoryData(explosionPosition, QVector2D(0.0f, 0.0f), GLColor(), first.spawnFrame);
+    m_bursts << TrajectoryBurst(particles.size(), qMax(endFrame, (int)first.spawnFrame + EXPLOSION_DURATION), (int)first.maxTail);
+    m_trailLength = qMax(m_trailLength, (int)first.maxTail + 1);
+    m_liveParticles += particles.size();
+}
+
+void AnalyticParticleSystem::update(int frame)
+{
+    m_frame = frame;
+
+    // Finished bursts draw nothing, so they may stay in the buffers. The trail length follows the live ones,
+    // the budget shortens trails per burst.
+    int deadParticles = 0;
+    m_liveParticles = 0;
+    m_trailLength = 1;
+
+    for (int i = 0; i < m_bursts.size(); ++i) {
+        const TrajectoryBurst &burst = m_bursts.at(i);
+
+        if(burst.endFrame > frame) {
+            m_liveParticles += burst.count;
+            m_trailLength = qMax(m_trailLength, burst.maxTail + 1);
+        } else {
+            deadParticles += burst.count;
+        }
+    }
+
+    // Once they take up half of the buffer, the finished bursts are dropped wherever they are and the live ones
+    // are moved down, keeping their order. A later burst may end first, so the finished ones are not only in front.
+    if(deadParticles <= m_liveParticles)
+        return;
+
+    int read = 0, written = 0, bursts = 0;
+
+    for (int i = 0; i < m_bursts.size(); ++i) {
+        const TrajectoryBurst burst = m_bursts.at(i);
+
+        if(burst.endFrame > frame) {
+            if(read != written) {
+                for (int j = 0; j < burst.count; ++j)
+                    m_particles[written + j] = m_particles.at(read + j);
+            }
+
+            m_explosions[bursts] = m_explosions.at(i);
+            m_bursts[bursts++] = burst;
+            written += burst.count;
+        }
+
+        read += burst.count;
+    }
+
+    m_particles.resize(written);
+    m_explosions.resize(bursts);
+    m_bursts.resize(bursts);
+
+    // Moved bursts have to be written again, the whole buffers are replaced
+    m_uploadedParticles = 0;
+    m_uploadedExplosions = 0;
+}
+
+void AnalyticParticleSystem::draw(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture)
+{
+    upload();
+    drawInstances(m_particleProgram, m_vertexArrays[0], m_trailLength, m_particles.size(), modelViewProjection, texture);
+}
+
+void AnalyticParticleSystem::drawExplosions(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture)
+{
+    upload();
+    drawInstances(m_explosionProgram, m_vertexArrays[1], 1, m_explosions.size(), modelViewProjection, texture);
+}
+
+int AnalyticParticleSystem::count() const
+{
+    return m_liveParticles;
+}
+
+void AnalyticParticleSystem::setupVertexArray(GLuint vertexArray, QOpenGLBuffer *buffer)
+{
+    GLStateCache &state = m_resourceManager->state();
+
+    state.bindVertexArray(vertexArray);
+    state.bindBuffer(GL_ARRAY_BUFFER, buffer->bufferId());
+
+    // One instance per particle, the vertices of an instance are its trail nodes
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TrajectoryData), (const void *)offsetof(TrajectoryData, origin));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TrajectoryData), (const void *)offsetof(TrajectoryData, velocity));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TrajectoryData), (const void *)offsetof(TrajectoryData, color));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(TrajectoryData), (const void *)offsetof(TrajectoryData, spawnFrame));
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(TrajectoryData), (const void *)offsetof(TrajectoryData, seed));
+
+    for(GLuint i = 0; i < 5; ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
+
+void AnalyticParticleSystem::upload()
+{
+    if(m_uploadedParticles == m_particles.size() && m_uploadedExplosions == m_explosions.size())
+        return;
+
+    TRACE_SCOPE("AnalyticParticleSystem::upload");
+
+    uploadTail(m_particleBuffer, m_particles, m_uploadedParticles);
+    uploadTail(m_explosionBuffer, m_explosions, m_uploadedExplosions);
+}
+
+void AnalyticParticleSystem::uploadTail(QOpenGLBuffer *buffer, const QVector<TrajectoryData> &data, int &uploaded)
+{
+    if(uploaded == data.size())
+        return;
+
+    // Earlier draws never read past the uploaded part, so new bursts are written there without a stall.
+    // When they do not fit, or after compaction, the whole buffer is replaced.
+    bool appended = uploaded > 0
+                    && m_resourceManager->writeVertexData(buffer, uploaded * sizeof(TrajectoryData), data.constData() + uploaded,
+                                                          (data.size() - uploaded) * sizeof(TrajectoryData));
+    if(!appended && !data.isEmpty())
+        m_resourceManager->streamVertexData(buffer, data.constData(), data.size() * sizeof(TrajectoryData));
+
+    uploaded = data.size();
+}
+
+void AnalyticParticleSystem::drawInstances(QOpenGLShaderProgram *program, GLuint vertexArray, int vertices, int instances,
+                                           const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture)
+{
+    if(!instances)
+        return;
+
+    m_resourceManager->bindShaderProgram(program);
+    program->setUniformValue("tex", 0);
+    program->setUniformValue("time", (GLfloat)m_frame);
+    program->setUniformValue("modelViewProjectionMatrix", modelViewProjection);
+    m_resourceManager->bindTexture(texture);
+
+    m_resourceManager->state().bindVertexArray(vertexArray);
+    glDrawArraysInstanced(GL_POINTS, 0, vertices, instances);
+}
@@ -0,0 +1,124 @@
+#ifndef ANALYTICPARTICLESYSTEM_H
+#define ANALYTICPARTICLESYSTEM_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QString>
+#include "resourcemanager.h"
+#include "firework.h"
+
+/*! Параметры частицы на момент взрыва. Из них вершинный шейдер вычисляет положение в любом кадре. */
+struct TrajectoryData
+{
+    QVector2D origin;
+    QVector2D velocity;
+    GLColor color;
+    GLfloat spawnFrame;
+    GLfloat flightDuration;
+    GLfloat maxTail;
+    GLfloat size;
+    GLfloat seed;
+    GLfloat blink;
+
+    TrajectoryData(QVector2D origin = QVector2D(0.0f, 0.0f),
+                   QVector2D velocity = QVector2D(0.0f, 0.0f),
+                   GLColor color = GLColor(1.0f, 1.0f, 1.0f, 1.0f),
+                   GLfloat spawnFrame = 0.0f,
+                   GLfloat flightDuration = 0.0f,
+                   GLfloat maxTail = 0.0f,
+                   GLfloat size = 1.0f,
+                   GLfloat seed = 0.0f,
+                   GLfloat blink = 0.0f)
+        : origin(origin)
+        , velocity(velocity)
+        , color(color)
+        , spawnFrame(spawnFrame)
+        , flightDuration(flightDuration)
+        , maxTail(maxTail)
+        , size(size)
+        , seed(seed)
+        , blink(blink) {}
+};
+
+struct TrajectoryBurst
+{
+    int count;
+    int endFrame;
+    int maxTail;
+
+    TrajectoryBurst(int count = 0, int endFrame = 0, int maxTail = 0)
+        : count(count)
+        , endFrame(endFrame)
+        , maxTail(maxTail) {}
+};
+
+/*!
+  @brief Класс частиц с траекториями в замкнутой форме.
+
+  Каждый залп загружается один раз параметрами взрыва. Положение, след, мерцание и кадр анимации взрыва
+  вычисляются в вершинном шейдере по номеру кадра, поэтому летящий залп ничего не стоит CPU.
+  Новые залпы дописываются в конец буффера. Догоревшие залпы ничего не рисуют и остаются в буффере,
+  пока не займут его половину, тогда живые сдвигаются к началу и буффер загружается заново.
+  */
+
+
+class AnalyticParticleSystem: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса AnalyticParticleSystem. */
+    AnalyticParticleSystem();
+
+    /*! Деструктор класса AnalyticParticleSystem. */
+    ~AnalyticParticleSystem();
+
+    /*! Создаёт буфферы и программы для фейерверков типа <i>type</i>. Не вызывать до ResourceManager::init()! */
+    bool init(ResourceManager &resourceManager, FireworkTypes type);
+
+    /*!
+     * Добавляет залп <i>particles</i> со взрывом в <i>explosionPosition</i>. У всех частиц залпа должны быть
+     * одинаковые кадр появления, время полёта и длина следа.
+     */
+    void emitBurst(const QVector<TrajectoryData> &particles, const QVector2D &explosionPosition);
+
+    /*! Устанавливает текущий кадр <i>frame</i> и убирает догоревшие залпы. */
+    void update(int frame);
+
+    /*! Рисует частицы с их следами. Меняет текущий VAO и программу. */
+    void draw(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture);
+
+    /*! Рисует анимацию взрывов. Меняет текущий VAO и программу. */
+    void drawExplosions(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture);
+
+    /*! Возвращает количество частиц без учёта следов. */
+    int count() const;
+
+private:
+    void setupVertexArray(GLuint vertexArray, QOpenGLBuffer *buffer);
+    void upload();
+    void uploadTail(QOpenGLBuffer *buffer, const QVector<TrajectoryData> &data, int &uploaded);
+    void drawInstances(QOpenGLShaderProgram *program, GLuint vertexArray, int vertices, int instances,
+                       const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture);
+
+    static const int EXPLOSION_DURATION = 64;
+
+    ResourceManager *m_resourceManager;
+    QOpenGLShaderProgram *m_particleProgram;
+    QOpenGLShaderProgram *m_explosionProgram;
+
+    QVector<TrajectoryData> m_particles;
+    QVector<TrajectoryData> m_explosions;
+    QVector<TrajectoryBurst> m_bursts;
+    QOpenGLBuffer *m_particleBuffer;
+    QOpenGLBuffer *m_explosionBuffer;
+    GLuint m_vertexArrays[2];
+
+    int m_trailLength;
+    int m_frame;
+    int m_liveParticles;
+    int m_uploadedParticles;
+    int m_uploadedExplosions;
+};
+
+#endif // ANALYTICPARTICLESYSTEM_H
@@ -0,0 +1,103 @@
+#include "assetpack.h"
+#include <QtDebug>
+
+AssetPack::AssetPack()
+    : m_mapping(NULL)
+    , m_size(0)
+{
+}
+
+AssetPack::~AssetPack()
+{
+    close();
+}
+
+bool AssetPack::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+
+    if(!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    m_mapping = m_file.map(0, m_size);
+
+    if(!m_mapping || m_size < (qint64)sizeof(AssetPackHeader)) {
+        qWarning() << QStringLiteral("AssetPack: failed to map '") + fileName + QStringLiteral("'!");
+        close();
+        return false;
+    }
+
+    const AssetPackHeader *header = (const AssetPackHeader *)m_mapping;
+
+    if(header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION
+            || m_size < (qint64)(sizeof(AssetPackHeader) + header->entryCount * sizeof(AssetPackEntry))) {
+        qWarning() << QStringLiteral("AssetPack: '") + fileName + QStringLiteral("' is not a valid asset pack!");
+        close();
+        return false;
+    }
+
+    const AssetPackEntry *entries = (const AssetPackEntry *)(m_mapping + sizeof(AssetPackHeader));
+
+    for(quint32 i = 0; i < header->entryCount; ++i) {
+        const AssetPackEntry &entry = entries[i];
+
+        if(entry.format > (quint32)AssetFormats::Bc3 || entry.offset > (quint64)m_size || entry.size > (quint64)m_size - entry.offset
+                || entry.size != dataSize((AssetFormats)entry.format, entry.width, entry.height)) {
+            qWarning() << QStringLiteral("AssetPack: skipped a broken entry in '") + fileName + QStringLiteral("'.");
+            continue;
+        }
+
+        m_entries.insert(QString::fromUtf8(entry.name, qstrnlen(entry.name, sizeof(entry.name))), &entry);
+    }
+
+    qDebug() << QStringLiteral("AssetPack: opened '") + fileName + QStringLiteral("' with") << m_entries.size() << QStringLiteral("assets.");
+
+    return true;
+}
+
+void AssetPack::close()
+{
+    m_entries.clear();
+
+    if(m_mapping) {
+        m_file.unmap(m_mapping);
+        m_mapping = NULL;
+    }
+
+    m_file.close();
+    m_size = 0;
+}
+
+bool AssetPack::isOpen() const
+{
+    return m_mapping != NULL;
+}
+
+const AssetPackEntry *AssetPack::entry(const QString &name) const
+{
+    return m_entries.value(name, NULL);
+}
+
+const uchar *AssetPack::data(const AssetPackEntry *entry) const
+{
+    return m_mapping + entry->offset;
+}
+
+quint64 AssetPack::dataSize(AssetFormats format, quint32 width, quint32 height)
+{
+    quint64 blocks = quint64((width + 3) / 4) * ((height + 3) / 4);
+
+    switch(format) {
+    case AssetFormats::Rgba8:
+        return quint64(width) * height * 4;
+    case AssetFormats::Bc1:
+        return blocks * 8;
+    case AssetFormats::Bc3:
+        return blocks * 16;
+    default:
+        return 0;
+    }
+}
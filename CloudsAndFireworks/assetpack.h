@@ -0,0 +1,83 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+// "CFAP" in a little-endian file
+const quint32 ASSET_PACK_MAGIC = 0x50414643;
+const quint32 ASSET_PACK_VERSION = 1;
+const quint32 ASSET_PACK_ALIGNMENT = 16;
+
+enum class AssetFormats : quint32
+{
+    Rgba8,
+    Bc1,
+    Bc3
+};
+
+struct AssetPackHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 entryCount;
+    quint32 reserved;
+};
+
+struct AssetPackEntry
+{
+    char name[64];
+    quint32 format;
+    quint32 width;
+    quint32 height;
+    quint32 reserved;
+    quint64 offset;
+    quint64 size;
+};
+
+/*!
+  @brief Класс пакета ресурсов.
+
+  Пакет содержит текстуры, уже подготовленные к загрузке в OpenGL: перевёрнутые, в формате RGBA8 или сжатые BC1/BC3.
+  Файл отображается в память целиком, данные текстур читаются прямо из отображения.
+  Пакет собирается утилитой tools/assetpacker.
+  */
+
+
+class AssetPack
+{
+
+public:
+    /*! Конструктор класса AssetPack. */
+    AssetPack();
+
+    /*! Деструктор класса AssetPack. */
+    ~AssetPack();
+
+    /*! Открывает и проверяет пакет <i>fileName</i>. Возвращает <i>true</i> при успешном открытии. */
+    bool open(const QString &fileName);
+
+    /*! Закрывает пакет. Данные, полученные из пакета, становятся недействительными. */
+    void close();
+
+    /*! Возвращает <i>true</i>, если пакет открыт. */
+    bool isOpen() const;
+
+    /*! Возвращает описание ресурса <i>name</i> или NULL, если его нет в пакете. */
+    const AssetPackEntry *entry(const QString &name) const;
+
+    /*! Возвращает указатель на данные ресурса <i>entry</i> внутри отображения файла. */
+    const uchar *data(const AssetPackEntry *entry) const;
+
+    /*! Возвращает ожидаемый размер данных текстуры формата <i>format</i> размера <i>width</i> x <i>height</i>. */
+    static quint64 dataSize(AssetFormats format, quint32 width, quint32 height);
+
+private:
+    QFile m_file;
+    uchar *m_mapping;
+    qint64 m_size;
+    QHash<QString, const AssetPackEntry*> m_entries;
+};
+
+#endif // ASSETPACK_H
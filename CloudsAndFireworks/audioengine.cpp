@@ -0,0 +1,391 @@
+#include "audioengine.h"
+#include "tracer.h"
+#include <QAudioOutput>
+#include <QAudioDeviceInfo>
+#include <QtEndian>
+#include <QtDebug>
+#include <cmath>
+#include <cstring>
+
+SoundEventQueue::SoundEventQueue()
+    : m_head(0)
+    , m_tail(0)
+{
+}
+
+bool SoundEventQueue::push(const SoundEvent &event)
+{
+    quint32 tail = m_tail.load(std::memory_order_relaxed);
+
+    if(tail - m_head.load(std::memory_order_acquire) >= CAPACITY)
+        return false;
+
+    m_events[tail % CAPACITY] = event;
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool SoundEventQueue::pop(SoundEvent &event)
+{
+    quint32 head = m_head.load(std::memory_order_relaxed);
+
+    if(head == m_tail.load(std::memory_order_acquire))
+        return false;
+
+    event = m_events[head % CAPACITY];
+    m_head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+AudioMixer::AudioMixer(const QVector< QVector<qint16> > &sounds, SoundEventQueue &queue, AudioStats &stats)
+    : m_sounds(sounds)
+    , m_queue(queue)
+    , m_stats(stats)
+    , m_voiceCount(0)
+    , m_sink(AudioSinks::Null)
+    , m_output(NULL)
+    , m_fileDataSize(0)
+{
+}
+
+bool AudioMixer::isSequential() const
+{
+    return true;
+}
+
+void AudioMixer::startSink(int sink, const QString &fileName)
+{
+    m_sink = (AudioSinks)sink;
+    QIODevice::open(QIODevice::ReadOnly);
+
+    if(m_sink == AudioSinks::Device) {
+        QAudioFormat format;
+        format.setSampleRate(SAMPLE_RATE);
+        format.setChannelCount(CHANNELS);
+        format.setSampleSize(16);
+        format.setCodec(QStringLiteral("audio/pcm"));
+        format.setByteOrder(QAudioFormat::LittleEndian);
+        format.setSampleType(QAudioFormat::SignedInt);
+
+        if(!QAudioDeviceInfo::defaultOutputDevice().isFormatSupported(format)) {
+            qWarning() << QStringLiteral("AudioMixer: the output device does not support 48 kHz stereo, sound is disabled!");
+            m_sink = AudioSinks::Null;
+            return;
+        }
+
+        // About 50 ms of buffering, the device pulls the mix through readData()
+        m_output = new QAudioOutput(format, this);
+        m_output->setBufferSize(SAMPLE_RATE * CHANNELS * sizeof(qint16) / 20);
+        m_output->start(this);
+    } else if(m_sink == AudioSinks::File) {
+        m_file.setFileName(fileName);
+
+        if(!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << QStringLiteral("AudioMixer: failed to open '") + fileName + QStringLiteral("'!");
+            m_sink = AudioSinks::Null;
+            return;
+        }
+
+        m_fileDataSize = 0;
+        writeWavHeader(0);
+    }
+}
+
+void AudioMixer::renderFrame()
+{
+    if(m_sink == AudioSinks::Device)
+        return;
+
+    // Offline sinks advance by exactly one animation frame, so a recording does not depend on the frame rate
+    int frames = SAMPLE_RATE / FRAME_RATE;
+    m_frameBuffer.resize(frames * CHANNELS);
+    mix(m_frameBuffer.data(), frames);
+
+    if(m_sink == AudioSinks::File && m_file.isOpen()) {
+        int bytes = m_frameBuffer.size() * sizeof(qint16);
+        m_file.write((const char *)m_frameBuffer.constData(), bytes);
+        m_fileDataSize += bytes;
+    }
+}
+
+void AudioMixer::stopSink()
+{
+    if(m_output) {
+        m_output->stop();
+        delete m_output;
+        m_output = NULL;
+    }
+
+    if(m_file.isOpen()) {
+        writeWavHeader(m_fileDataSize);
+        m_file.close();
+    }
+
+    QIODevice::close();
+}
+
+qint64 AudioMixer::readData(char *data, qint64 maxSize)
+{
+    int frames = maxSize / (CHANNELS * sizeof(qint16));
+
+    mix((qint16 *)data, frames);
+
+    return frames * CHANNELS * sizeof(qint16);
+}
+
+qint64 AudioMixer::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
+
+void AudioMixer::mix(qint16 *output, int frames)
+{
+    TRACE_SCOPE("AudioMixer::mix");
+
+    SoundEvent event;
+
+    while(m_queue.pop(event))
+        startVoice(event);
+
+    m_accumulator.fill(0, frames * CHANNELS);
+    qint32 *accumulator = m_accumulator.data();
+
+    for(int i = 0; i < m_voiceCount; ++i) {
+        Voice &voice = m_voices[i];
+        const QVector<qint16> &samples = m_sounds.at(voice.sound);
+        int count = qMin(frames * CHANNELS, samples.size() - voice.position);
+        const qint16 *source = samples.constData() + voice.position;
+
+        for(int j = 0; j < count; ++j)
+            accumulator[j] += qint32(source[j] * voice.gain);
+
+        voice.position += count;
+
+        // Finished voices are replaced by the last one, the order of the pool does not matter
+        if(voice.position >= samples.size())
+            m_voices[i--] = m_voices[--m_voiceCount];
+    }
+
+    for(int j = 0; j < frames * CHANNELS; ++j)
+        output[j] = (qint16)qBound(-32768, accumulator[j], 32767);
+}
+
+void AudioMixer::startVoice(const SoundEvent &event)
+{
+    if(m_sounds.at((int)event.sound).isEmpty())
+        return;
+
+    int index = m_voiceCount;
+
+    // The pool is full: the voice closest to its end is the least audible one and is stolen
+    if(m_voiceCount == MAX_VOICES) {
+        index = 0;
+        for(int i = 1; i < m_voiceCount; ++i) {
+            if(m_sounds.at(m_voices[i].sound).size() - m_voices[i].position < m_sounds.at(m_voices[index].sound).size() - m_voices[index].position)
+                index = i;
+        }
+        m_stats.stolen.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        ++m_voiceCount;
+    }
+
+    // Coalesced events are louder, but not as loud as the same number of separate voices
+    m_voices[index].sound = (int)event.sound;
+    m_voices[index].position = 0;
+    m_voices[index].gain = qMin(1.0f, 0.6f * (1.0f + 0.25f * log2f((float)event.count)));
+}
+
+void AudioMixer::writeWavHeader(quint32 dataSize)
+{
+    char header[44];
+
+    memcpy(header, "RIFF", 4);
+    qToLittleEndian<quint32>(36 + dataSize, (uchar *)header + 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, (uchar *)header + 16);
+    qToLittleEndian<quint16>(1, (uchar *)header + 20);
+    qToLittleEndian<quint16>(CHANNELS, (uchar *)header + 22);
+    qToLittleEndian<quint32>(SAMPLE_RATE, (uchar *)header + 24);
+    qToLittleEndian<quint32>(SAMPLE_RATE * CHANNELS * sizeof(qint16), (uchar *)header + 28);
+    qToLittleEndian<quint16>(CHANNELS * sizeof(qint16), (uchar *)header + 32);
+    qToLittleEndian<quint16>(16, (uchar *)header + 34);
+    memcpy(header + 36, "data", 4);
+    qToLittleEndian<quint32>(dataSize, (uchar *)header + 40);
+
+    m_file.seek(0);
+    m_file.write(header, sizeof(header));
+    m_file.seek(m_file.size());
+}
+
+AudioEngine &AudioEngine::instance()
+{
+    static AudioEngine engine;
+    return engine;
+}
+
+AudioEngine::AudioEngine()
+    : m_mixer(NULL)
+    , m_sink(AudioSinks::Null)
+{
+    for(int i = 0; i < (int)Sounds::Count; ++i)
+        m_pending[i] = 0;
+
+    m_thread.setObjectName(QStringLiteral("Audio"));
+}
+
+AudioEngine::~AudioEngine()
+{
+    stop();
+}
+
+bool AudioEngine::start(AudioSinks sink, const QString &fileName)
+{
+    TRACE_SCOPE("AudioEngine::start");
+
+    if(m_mixer)
+        return true;
+
+    QVector< QVector<qint16> > sounds((int)Sounds::Count);
+    sounds[(int)Sounds::Explosion] = loadWav(QStringLiteral(":/sounds/explosion.wav"));
+    sounds[(int)Sounds::Fizz] = loadWav(QStringLiteral(":/sounds/fizz.wav"));
+
+    m_sink = sink;
+    m_mixer = new AudioMixer(sounds, m_queue, m_stats);
+    m_mixer->moveToThread(&m_thread);
+    m_thread.start();
+
+    // The audio output has to be created in the thread it is used from
+    QMetaObject::invokeMethod(m_mixer, "startSink", Qt::QueuedConnection, Q_ARG(int, (int)sink), Q_ARG(QString, fileName));
+
+    return true;
+}
+
+void AudioEngine::stop()
+{
+    if(!m_mixer)
+        return;
+
+    QMetaObject::invokeMethod(m_mixer, "stopSink", Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+
+    delete m_mixer;
+    m_mixer = NULL;
+}
+
+void AudioEngine::play(Sounds sound)
+{
+    m_pending[(int)sound].fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioEngine::endFrame()
+{
+    for(int i = 0; i < (int)Sounds::Count; ++i) {
+        quint32 count = m_pending[i].exchange(0, std::memory_order_relaxed);
+
+        if(!count || !m_mixer)
+            continue;
+
+        m_stats.events.fetch_add(count, std::memory_order_relaxed);
+        m_stats.coalesced.fetch_add(count - 1, std::memory_order_relaxed);
+
+        if(!m_queue.push(SoundEvent((Sounds)i, count)))
+            m_stats.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if(m_mixer && m_sink != AudioSinks::Device)
+        QMetaObject::invokeMethod(m_mixer, "renderFrame", Qt::QueuedConnection);
+}
+
+const AudioStats &AudioEngine::stats() const
+{
+    return m_stats;
+}
+
+AudioSinks AudioEngine::sinkFromString(const QString &value)
+{
+    if(value == QLatin1String("device"))
+        return AudioSinks::Device;
+    if(value == QLatin1String("null"))
+        return AudioSinks::Null;
+    return AudioSinks::File;
+}
+
+QVector<qint16> AudioEngine::loadWav(const QString &fileName)
+{
+    QVector<qint16> result;
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << QStringLiteral("AudioEngine: failed to open '") + fileName + QStringLiteral("'!");
+        return result;
+    }
+
+    QByteArray data = file.readAll();
+    const uchar *bytes = (const uchar *)data.constData();
+
+    if(data.size() < 12 || memcmp(bytes, "RIFF", 4) || memcmp(bytes + 8, "WAVE", 4)) {
+        qWarning() << QStringLiteral("AudioEngine: '") + fileName + QStringLiteral("' is not a WAV file!");
+        return result;
+    }
+
+    int channels = 0, sampleRate = 0, bits = 0, format = 0;
+    const uchar *samples = NULL;
+    int sampleCount = 0;
+
+    // Chunks other than "fmt " and "data" (LIST, fact...) are skipped
+    for(int offset = 12; offset + 8 <= data.size();) {
+        quint32 chunkSize = qFromLittleEndian<quint32>(bytes + offset + 4);
+        const uchar *chunk = bytes + offset + 8;
+
+        if(offset + 8 + (qint64)chunkSize > data.size())
+            chunkSize = data.size() - offset - 8;
+
+        if(!memcmp(bytes + offset, "fmt ", 4) && chunkSize >= 16) {
+            format = qFromLittleEndian<quint16>(chunk);
+            channels = qFromLittleEndian<quint16>(chunk + 2);
+            sampleRate = qFromLittleEndian<quint32>(chunk + 4);
+            bits = qFromLittleEndian<quint16>(chunk + 14);
+        } else if(!memcmp(bytes + offset, "data", 4)) {
+            samples = chunk;
+            sampleCount = chunkSize / sizeof(qint16);
+        }
+
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if(format != 1 || bits != 16 || (channels != 1 && channels != 2) || !sampleRate || !samples) {
+        qWarning() << QStringLiteral("AudioEngine: '") + fileName + QStringLiteral("' is not 16 bit PCM!");
+        return result;
+    }
+
+    // Converted once to the mixer format, linear interpolation is enough for effects
+    int inputFrames = sampleCount / channels;
+    int outputFrames = qint64(inputFrames) * AudioMixer::SAMPLE_RATE / sampleRate;
+    double step = (double)sampleRate / AudioMixer::SAMPLE_RATE;
+
+    result.resize(outputFrames * AudioMixer::CHANNELS);
+
+    for(int i = 0; i < outputFrames; ++i) {
+        double position = i * step;
+        int index = qMin((int)position, inputFrames - 1);
+        int next = qMin(index + 1, inputFrames - 1);
+        float fraction = position - index;
+
+        for(int c = 0; c < AudioMixer::CHANNELS; ++c) {
+            int channel = qMin(c, channels - 1);
+            float first = qFromLittleEndian<qint16>(samples + (index * channels + channel) * sizeof(qint16));
+            float second = qFromLittleEndian<qint16>(samples + (next * channels + channel) * sizeof(qint16));
+            result[i * AudioMixer::CHANNELS + c] = (qint16)qRound(first + (second - first) * fraction);
+        }
+    }
+
+    qDebug() << QStringLiteral("AudioEngine: loaded '") + fileName + QStringLiteral("',") << outputFrames << QStringLiteral("frames.");
+
+    return result;
+}
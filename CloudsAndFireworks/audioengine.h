@@ -0,0 +1,189 @@
+#ifndef AUDIOENGINE_H
+#define AUDIOENGINE_H
+
+#include <QIODevice>
+#include <QThread>
+#include <QVector>
+#include <QString>
+#include <QFile>
+#include <atomic>
+
+class QAudioOutput;
+
+enum class Sounds
+{
+    Explosion,
+    Fizz,
+    Count
+};
+
+enum class AudioSinks
+{
+    Device,
+    Null,
+    File
+};
+
+struct SoundEvent
+{
+    Sounds sound;
+    quint32 count;
+
+    SoundEvent(Sounds sound = Sounds::Explosion, quint32 count = 1)
+        : sound(sound)
+        , count(count) {}
+};
+
+struct AudioStats
+{
+    std::atomic<quint64> events;
+    std::atomic<quint64> coalesced;
+    std::atomic<quint64> dropped;
+    std::atomic<quint64> stolen;
+
+    AudioStats()
+        : events(0)
+        , coalesced(0)
+        , dropped(0)
+        , stolen(0) {}
+};
+
+/*!
+  @brief Очередь звуковых событий без блокировок.
+
+  Один поток пишет, другой читает. При переполнении событие отбрасывается.
+  */
+
+
+class SoundEventQueue
+{
+
+public:
+    SoundEventQueue();
+
+    /*! Добавляет событие. Возвращает <i>false</i>, если очередь заполнена. Вызывать только из потока-писателя. */
+    bool push(const SoundEvent &event);
+
+    /*! Забирает событие в <i>event</i>. Возвращает <i>false</i>, если очередь пуста. Вызывать только из потока-читателя. */
+    bool pop(SoundEvent &event);
+
+private:
+    static const quint32 CAPACITY = 256;
+
+    SoundEvent m_events[CAPACITY];
+    std::atomic<quint32> m_head;
+    std::atomic<quint32> m_tail;
+};
+
+/*!
+  @brief Класс микшера.
+
+  Живёт в потоке звука. Смешивает ограниченное число голосов из заранее декодированных звуков
+  и отдаёт результат устройству вывода, пишет в WAV-файл или отбрасывает.
+  */
+
+
+class AudioMixer: public QIODevice
+{
+    Q_OBJECT
+
+public:
+    /*! Конструктор класса AudioMixer. <i>sounds</i> - стерео 16 бит с частотой SAMPLE_RATE. */
+    AudioMixer(const QVector< QVector<qint16> > &sounds, SoundEventQueue &queue, AudioStats &stats);
+
+    bool isSequential() const Q_DECL_OVERRIDE;
+
+    static const int SAMPLE_RATE = 48000;
+    static const int CHANNELS = 2;
+    static const int MAX_VOICES = 16;
+    static const int FRAME_RATE = 60;
+
+public slots:
+    /*! Открывает вывод <i>sink</i>. Для AudioSinks::File звук пишется в <i>fileName</i>. */
+    void startSink(int sink, const QString &fileName);
+
+    /*! Смешивает один кадр анимации. Для вывода в файл или в никуда, устройство забирает звук само. */
+    void renderFrame();
+
+    /*! Закрывает вывод. */
+    void stopSink();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 writeData(const char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+
+private:
+    struct Voice
+    {
+        int sound;
+        int position;
+        float gain;
+    };
+
+    void mix(qint16 *output, int frames);
+    void startVoice(const SoundEvent &event);
+    void writeWavHeader(quint32 dataSize);
+
+    QVector< QVector<qint16> > m_sounds;
+    SoundEventQueue &m_queue;
+    AudioStats &m_stats;
+
+    Voice m_voices[MAX_VOICES];
+    int m_voiceCount;
+    QVector<qint32> m_accumulator;
+    QVector<qint16> m_frameBuffer;
+
+    AudioSinks m_sink;
+    QAudioOutput *m_output;
+    QFile m_file;
+    quint32 m_fileDataSize;
+};
+
+/*!
+  @brief Класс звукового движка.
+
+  Декодирует все звуки один раз при запуске. События play() собираются за кадр без блокировок,
+  в endFrame() одинаковые события сливаются в одно с большей громкостью и уходят в поток микшера.
+  */
+
+
+class AudioEngine
+{
+
+public:
+    /*! Возвращает единственный экземпляр звукового движка. */
+    static AudioEngine &instance();
+
+    /*! Загружает звуки и запускает поток микшера с выводом <i>sink</i>. */
+    bool start(AudioSinks sink, const QString &fileName = QString());
+
+    /*! Останавливает поток микшера. Вызывать до выхода из main(). */
+    void stop();
+
+    /*! Запрашивает звук <i>sound</i> в текущем кадре. Не блокирует, можно вызывать из любого потока. */
+    void play(Sounds sound);
+
+    /*! Отправляет накопленные за кадр события микшеру. Вызывать один раз за кадр из одного потока. */
+    void endFrame();
+
+    /*! Возвращает счётчики событий, слитых событий, потерянных событий и перехваченных голосов. */
+    const AudioStats &stats() const;
+
+    /*! Разбирает вывод из командной строки: "device", "null" или имя WAV-файла. */
+    static AudioSinks sinkFromString(const QString &value);
+
+private:
+    AudioEngine();
+    ~AudioEngine();
+    static QVector<qint16> loadWav(const QString &fileName);
+
+    std::atomic<quint32> m_pending[(int)Sounds::Count];
+    SoundEventQueue m_queue;
+    AudioStats m_stats;
+
+    QThread m_thread;
+    AudioMixer *m_mixer;
+    AudioSinks m_sink;
+};
+
+#endif // AUDIOENGINE_H
@@ -0,0 +1,288 @@
+#include "benchmark.h"
+#include "renderer.h"
+#include "audioengine.h"
+#include "inputlog.h"
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QtDebug>
+#include <ctime>
+
+Benchmark::Benchmark(const BenchmarkOptions &options)
+    : m_options(options)
+    , m_renderer(NULL)
+    , m_replay(NULL)
+    , m_replayIndex(0)
+{
+}
+
+int Benchmark::run()
+{
+    InputLog replay;
+
+    // A replay renders the recorded show with its own seed, size, settings and length instead of the script
+    if(!m_options.replayFileName.isEmpty()) {
+        if(!replay.load(m_options.replayFileName) || !replay.frames()) {
+            qCritical("Benchmark: failed to load the replay!");
+            return 1;
+        }
+
+        m_options.seed = replay.seed();
+        m_options.width = replay.width();
+        m_options.height = replay.height();
+        m_options.frames = replay.frames();
+        m_options.warmupFrames = 0;
+        m_options.launchInterval = 0;
+        m_options.simulation = replay.simulation();
+        m_options.particleBudget = replay.particleBudget();
+
+        m_replay = &replay;
+        m_replayIndex = 0;
+    }
+
+    if(!m_options.showFileName.isEmpty() && !m_showScheduler.open(m_options.showFileName)) {
+        qCritical("Benchmark: failed to open the show!");
+        return 1;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+
+    QOpenGLContext context;
+    context.setFormat(QSurfaceFormat::defaultFormat());
+
+    if(!context.create() || !context.makeCurrent(&surface)) {
+        qCritical("Benchmark: failed to create an OpenGL context!");
+        return 1;
+    }
+
+    QOpenGLFunctions *functions = context.functions();
+    QTextStream out(stdout);
+
+    out << "Renderer: " << (const char *)functions->glGetString(GL_RENDERER) << '\n'
+        << "Version:  " << (const char *)functions->glGetString(GL_VERSION) << '\n';
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    QOpenGLFramebufferObject target(m_options.width, m_options.height, fboFormat);
+
+    qsrand(m_options.seed);
+
+    Renderer renderer(m_options.width, m_options.height);
+    m_renderer = &renderer;
+
+    renderer.resourceManager().memory().setBudget(qint64(m_options.vramBudgetMb) * 1048576);
+    renderer.resolutionScaler().setBounds(m_options.minRenderScale, m_options.maxRenderScale);
+    renderer.resolutionScaler().setTargetFrameRate(m_options.targetFps);
+    renderer.setSimulationMode(m_options.simulation);
+    renderer.setSimulationCheck(m_options.checkSimulation);
+    renderer.particleBudget().setBudget(m_options.particleBudget);
+    renderer.resourceManager().memory().registerAllocation(&target, GpuMemoryCategories::Framebuffers, QStringLiteral("Benchmark target"),
+                                                           QStringLiteral("RGBA8+D24S8"), qint64(m_options.width) * m_options.height * 8);
+
+    if(!m_options.captureFileName.isEmpty())
+        renderer.setCaptureFile(m_options.captureFileName, FrameCapture::formatFromFileName(m_options.captureFileName));
+
+    renderer.initialize();
+    renderer.resize(m_options.width, m_options.height);
+
+    FrameProfiler &profiler = renderer.resourceManager().profiler();
+    profiler.setRecording(!m_options.timingsFileName.isEmpty());
+
+    QElapsedTimer timer;
+    std::clock_t cpuStart = 0;
+    uint fireworksPeak = 0;
+    quint64 stateIssued = 0, stateSkipped = 0;
+    double scaleSum = 0.0;
+    float scaleMin = 1.0f;
+
+    for(uint frame = 0; frame < m_options.warmupFrames + m_options.frames; ++frame) {
+
+        if(frame == m_options.warmupFrames) {
+            functions->glFinish();
+            profiler.finish();
+            profiler.resetTotals();
+
+            timer.start();
+            cpuStart = std::clock();
+
+            if(m_options.stress)
+                m_stressTest.start(m_options.stressOptions);
+
+            m_showScheduler.start(renderer.renderedFrames());
+        }
+
+        runScript(frame);
+
+        renderer.render(target.handle());
+        renderer.advanceFrame();
+
+        // Stands in for the buffer swap, so that the driver starts executing the frame
+        functions->glFlush();
+
+        fireworksPeak = qMax(fireworksPeak, (uint)renderer.fireworksCount());
+
+        if(frame >= m_options.warmupFrames) {
+            scaleSum += renderer.resolutionScaler().scale();
+            scaleMin = qMin(scaleMin, renderer.resolutionScaler().scale());
+            stateIssued += renderer.resourceManager().state().lastFrame().totalIssued();
+            stateSkipped += renderer.resourceManager().state().lastFrame().totalSkipped();
+        }
+
+        // The run ends with the stress test, the report covers only the frames rendered until then
+        if(m_stressTest.isFinished() && frame >= m_options.warmupFrames)
+            m_options.frames = frame + 1 - m_options.warmupFrames;
+    }
+
+    functions->glFinish();
+
+    double wallSeconds = timer.nsecsElapsed() / 1000000000.0;
+    double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    profiler.finish();
+    FrameTimings timings = profiler.totalAverage();
+
+    out << "Frames:   " << m_options.frames << " (+" << m_options.warmupFrames << " warm-up) at "
+        << m_options.width << 'x' << m_options.height << '\n'
+        << "Fireworks peak: " << fireworksPeak << '\n'
+        << "Dropped GPU timings: " << profiler.droppedFrames() << '\n'
+        << QStringLiteral("Wall time: %1 s, %2 fps").arg(wallSeconds, 0, 'f', 3).arg(wallSeconds > 0.0 ? m_options.frames / wallSeconds : 0.0, 0, 'f', 1) << '\n'
+        << QStringLiteral("Process CPU time: %1 ms/frame").arg(cpuSeconds * 1000.0 / qMax(m_options.frames, 1u), 0, 'f', 3) << '\n'
+        << QStringLiteral("Render scale: %1 average, %2 minimum").arg(scaleSum / qMax(m_options.frames, 1u), 0, 'f', 2).arg(scaleMin, 0, 'f', 2) << '\n'
+        << QStringLiteral("GL state calls: %1 issued, %2 skipped per frame").arg(double(stateIssued) / qMax(m_options.frames, 1u), 0, 'f', 1)
+                                                                             .arg(double(stateSkipped) / qMax(m_options.frames, 1u), 0, 'f', 1) << '\n'
+        << "Simulation: " << Renderer::simulationModeName(m_options.simulation) << '\n'
+        << QStringLiteral("Particles: %1 peak, budget %2, %3 reduced requests").arg(renderer.particleBudget().peak())
+                                                                                .arg(m_options.particleBudget)
+                                                                                .arg(renderer.particleBudget().reducedRequests()) << '\n'
+        << QStringLiteral("Audio: %1 events, %2 coalesced, %3 dropped, %4 voices stolen").arg(AudioEngine::instance().stats().events.load())
+                                                                                         .arg(AudioEngine::instance().stats().coalesced.load())
+                                                                                         .arg(AudioEngine::instance().stats().dropped.load())
+                                                                                         .arg(AudioEngine::instance().stats().stolen.load()) << '\n';
+
+    if(m_options.stress)
+        out << "Stress test: " << m_stressTest.report() << '\n';
+
+    if(!m_options.showFileName.isEmpty())
+        out << QStringLiteral("Show: %1 of %2 frames, %3 launches, %4 cues skipped").arg(m_showScheduler.frame()).arg(m_showScheduler.frames())
+                                                                                    .arg(m_showScheduler.launched()).arg(m_showScheduler.skipped()) << '\n';
+
+    out << '\n';
+
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Pass"), -12).arg(QStringLiteral("CPU ms"), 10).arg(QStringLiteral("GPU ms"), 10) << '\n';
+
+    for(int i = 0; i < (int)ProfilerPasses::Count; ++i) {
+        out << QStringLiteral("%1 %2 %3").arg(FrameProfiler::passName((ProfilerPasses)i), -12)
+                                         .arg(timings.passes[i].cpuMs, 10, 'f', 3)
+                                         .arg(timings.passes[i].gpuMs, 10, 'f', 3) << '\n';
+    }
+
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Frame"), -12)
+                                     .arg(timings.cpuFrameMs, 10, 'f', 3)
+                                     .arg(timings.gpuFrameMs, 10, 'f', 3) << "\n\n";
+
+    const GpuMemoryTracker &memory = renderer.resourceManager().memory();
+
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("VRAM"), -12).arg(QStringLiteral("MiB"), 10).arg(QStringLiteral("peak MiB"), 10) << '\n';
+
+    for(int i = 0; i < (int)GpuMemoryCategories::Count; ++i) {
+        out << QStringLiteral("%1 %2 %3").arg(GpuMemoryTracker::categoryName((GpuMemoryCategories)i), -12)
+                                         .arg(memory.total((GpuMemoryCategories)i) / 1048576.0, 10, 'f', 2)
+                                         .arg(memory.peak((GpuMemoryCategories)i) / 1048576.0, 10, 'f', 2) << '\n';
+    }
+
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Total"), -12)
+                                     .arg(memory.total() / 1048576.0, 10, 'f', 2)
+                                     .arg(memory.peak() / 1048576.0, 10, 'f', 2) << '\n';
+
+    out.flush();
+
+    if(!m_options.dumpFileName.isEmpty()) {
+        if(target.toImage().save(m_options.dumpFileName)) {
+            qDebug() << QStringLiteral("Benchmark: last frame saved to '") + m_options.dumpFileName + QStringLiteral("'.");
+        } else {
+            qWarning() << QStringLiteral("Benchmark: failed to save '") + m_options.dumpFileName + QStringLiteral("'!");
+        }
+    }
+
+    if(!m_options.timingsFileName.isEmpty())
+        FrameProfiler::writeCsv(m_options.timingsFileName, profiler.recorded());
+
+    int result = 0;
+
+    // The test burst is only stepped once the GPU mode is used, so the other modes have nothing to report
+    if(m_options.simulation == SimulationModes::Gpu) {
+        bool verified = renderer.gpuSimulationError() <= GpuParticleSystem::CHECK_TOLERANCE;
+
+        out << '\n' << QStringLiteral("Simulation self-check: max error %1 (%2)").arg(renderer.gpuSimulationError(), 0, 'g', 3)
+                                                                                .arg(verified ? QStringLiteral("passed") : QStringLiteral("FAILED")) << '\n';
+        out.flush();
+
+        if(!verified)
+            result = 1;
+    }
+
+    // Both GPU systems step with the CPU integration of the same particles, any difference beyond rounding fails the run
+    if(m_options.checkSimulation) {
+        uint checkedFrames = 0;
+        float maxError = 0.0f;
+
+        for(int i = 0; i < (int)FireworkTypes::Count; ++i) {
+            checkedFrames += renderer.gpuParticles((FireworkTypes)i).checkedFrames();
+            maxError = qMax(maxError, renderer.gpuParticles((FireworkTypes)i).maxError());
+        }
+
+        bool passed = maxError <= GpuParticleSystem::CHECK_TOLERANCE;
+
+        out << '\n' << QStringLiteral("Simulation check: %1 steps, max error %2 (%3)").arg(checkedFrames).arg(maxError, 0, 'g', 3)
+                                                                                   .arg(passed ? QStringLiteral("passed") : QStringLiteral("FAILED")) << '\n';
+        out.flush();
+
+        if(!passed)
+            result = 1;
+    }
+
+    m_renderer = NULL;
+    m_replay = NULL;
+
+    return result;
+}
+
+void Benchmark::runScript(uint frame)
+{
+    if(m_options.stress) {
+        m_stressTest.update(*m_renderer);
+        return;
+    }
+
+    if(!m_options.showFileName.isEmpty()) {
+        m_showScheduler.update(*m_renderer);
+        return;
+    }
+
+    if(m_replay) {
+        const QVector<LaunchEvent> &events = m_replay->events();
+
+        for(; m_replayIndex < events.size() && events.at(m_replayIndex).frame <= frame; ++m_replayIndex)
+            m_renderer->launchFirework(QPointF(events.at(m_replayIndex).x, events.at(m_replayIndex).y));
+
+        return;
+    }
+
+    if(!m_options.launchInterval || frame % m_options.launchInterval)
+        return;
+
+    // A steady stream of launches in waves of one to three fireworks over the upper part of the screen
+    uint wave = 1 + (frame / m_options.launchInterval) % 3;
+
+    for(uint i = 0; i < wave; ++i) {
+        float x = qrand() % m_options.width;
+        float y = m_options.height * (0.1f + 0.35f * ((float)qrand() / (float)RAND_MAX));
+
+        m_renderer->launchFirework(QPointF(x, y));
+    }
+}
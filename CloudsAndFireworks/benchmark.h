@@ -0,0 +1,83 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include "gpuparticlesystem.h"
+#include "stresstest.h"
+#include "showscheduler.h"
+
+class Renderer;
+class InputLog;
+
+struct BenchmarkOptions
+{
+    uint frames;
+    uint warmupFrames;
+    uint width;
+    uint height;
+    uint seed;
+    uint launchInterval;
+    uint vramBudgetMb;
+    uint particleBudget;
+    float minRenderScale;
+    float maxRenderScale;
+    float targetFps;
+    SimulationModes simulation;
+    bool checkSimulation;
+    bool stress;
+    StressTestOptions stressOptions;
+    QString dumpFileName;
+    QString captureFileName;
+    QString replayFileName;
+    QString timingsFileName;
+    QString showFileName;
+
+    BenchmarkOptions()
+        : frames(1000)
+        , warmupFrames(30)
+        , width(1280)
+        , height(800)
+        , seed(1)
+        , launchInterval(10)
+        , vramBudgetMb(0)
+        , particleBudget(0)
+        , minRenderScale(1.0f)
+        , maxRenderScale(1.0f)
+        , targetFps(60.0f)
+        , simulation(SimulationModes::Cpu)
+        , checkSimulation(false)
+        , stress(false) {}
+};
+
+/*!
+  @brief Класс безоконного бенчмарка.
+
+  Рисует сцену в фреймбуффер на QOffscreenSurface с заданным сценарием запусков так быстро, как может,
+  и выводит частоту кадров и времена проходов на CPU и GPU. Работает и на программном Mesa llvmpipe.
+  Вместо сценария может проигрывать журнал ввода, записанный окном, файл шоу или запускать нагрузочный тест,
+  и сохранять времена каждого кадра.
+  */
+
+
+class Benchmark
+{
+
+public:
+    /*! Конструктор класса Benchmark. */
+    explicit Benchmark(const BenchmarkOptions &options);
+
+    /*! Запускает бенчмарк. Возвращает код завершения программы. */
+    int run();
+
+private:
+    void runScript(uint frame);
+
+    BenchmarkOptions m_options;
+    Renderer *m_renderer;
+    const InputLog *m_replay;
+    int m_replayIndex;
+    StressTest m_stressTest;
+    ShowScheduler m_showScheduler;
+};
+
+#endif // BENCHMARK_H
@@ -1,5 +1,6 @@
 #include "cloud.h"
 #include <cmath>
+#include "tracer.h"
 
 
 Cloud::Cloud()
@@ -89,6 +90,8 @@ QVector<uchar> Cloud::generateNoise2D(int size, float persistence, float frequen
 
 QImage Cloud::createCloud(int size, float persistence, float frequency, float amplitude)
 {
+    TRACE_SCOPE("Cloud::createCloud");
+
     QVector<uchar> data = generateNoise2D(size, persistence, frequency, amplitude);
 
     QImage result(size, size, QImage::Format_Grayscale8);
@@ -1,8 +1,11 @@
 #include "firework.h"
 #include <cmath>
-#include <QSound>
+#include "particleeffect.h"
+#include "audioengine.h"
+#include "tracer.h"
 
 const float Firework::GRAVITY = 0.02f;
+const float Firework::DAMPING = 0.96f;
 const float Firework::LAUNCH_POSITION_Y = 0.0f;
 const GLColor Firework::FIREWORK_COLORS[] = { GLColor(1.0f, 0.0f, 0.0f, 1.0f),
                                               GLColor(1.0f, 0.5f, 0.0f, 1.0f),
@@ -19,27 +22,83 @@ const GLColor Firework::FIREWORK_COLORS[] = { GLColor(1.0f, 0.0f, 0.0f, 1.0f),
 const uint Firework::FIREWORK_COLORS_SIZE = 11;
 const uint Firework::EXPLOSION_DURATION = 64;
 
-Firework::Firework(int posX, int posY)
-    : m_mouseClickedPosition((float)posX, (float)posY)
+namespace {
+
+// Every chain is its own loop with the affectors inlined, a new effect adds a chain instead of branches in the existing ones
+typedef ParticleAffectors<Motion, GroundClamp, Drag, Gravity> FlightAffectors;
+typedef ParticleAffectors<Motion, GroundClamp, Drag, Gravity, Blink> FlickerAffectors;
+typedef ParticleAffectors<Fade> RocketTailAffectors;
+
+FlightAffectors flightAffectors()
+{
+    return FlightAffectors(Motion(), GroundClamp(Firework::LAUNCH_POSITION_Y), Drag(Firework::DAMPING), Gravity(Firework::GRAVITY));
+}
+
+FlickerAffectors flickerAffectors(FireworkRandom &random)
+{
+    return FlickerAffectors(Motion(), GroundClamp(Firework::LAUNCH_POSITION_Y), Drag(Firework::DAMPING), Gravity(Firework::GRAVITY), Blink(random));
+}
+
+RocketTailAffectors rocketTailAffectors(uint maxTail)
+{
+    return RocketTailAffectors(Fade(GLColor(0.0f, (1.0 / (float)maxTail) * 1.3f, 0.0f, 1.0 / (float)maxTail)));
+}
+
+// Drops the particles from first on that faded out, keeping the order of the rest. Returns how many were dropped.
+int removeFaded(QVector<Particle> &particles, int first)
+{
+    int kept = first;
+
+    for (int i = first; i < particles.size(); ++i) {
+        if(particles.at(i).getColor().alpha > 0.0f)
+            particles[kept++] = particles.at(i);
+    }
+
+    int removed = particles.size() - kept;
+    particles.resize(kept);
+
+    return removed;
+}
+
+}
+
+Firework::Firework(int posX, int posY, ParticleBudget *budget, const FireworkParams *params)
+    : m_budget(budget)
+    , m_mouseClickedPosition((float)posX, (float)posY)
     , m_fizzPlayed(false)
+    , m_burstPending(false)
     , m_rocketSize(6.0f)
     , m_rocketMaxTail(30)
     , m_rocketCurrentTail(0)
+    , m_trailNewest(0)
+    , m_trailFirstAge(0)
     , m_particlesFlightDuration(120)
     , m_particlesMaxTail(30)
     , m_particlesCurrentTail(0)
+    , m_particlesTailStride(1)
     , m_curExplosionDuration(0)
+    , m_colorIndex(-1)
 {
-    m_fireworkLevel = 4 + (qrand() % 4);
-    m_particlesAngleOffset = ((float)qrand() / (float)RAND_MAX) * 360.0f;
-    m_particlesSize = 4.0f + ((float)qrand() / (float)RAND_MAX) * 2.0f;
+    if(params) {
+        m_random = FireworkRandom(params->seed);
+        m_fireworkType = params->type;
+        m_fireworkLevel = qBound(1u, params->level, (uint)FireworkParams::MAX_LEVEL);
+        m_colorIndex = (int)qMin(params->color, FIREWORK_COLORS_SIZE);
+    } else {
+        m_fireworkLevel = 4 + (m_random.next() % 4);
+    }
 
-    int type = qrand() % 3;
+    m_particlesAngleOffset = ((float)m_random.next() / (float)RAND_MAX) * 360.0f;
+    m_particlesSize = 4.0f + ((float)m_random.next() / (float)RAND_MAX) * 2.0f;
 
-    if(!type)
-        m_fireworkType = FireworkTypes::Blinks;
-    else
-        m_fireworkType = FireworkTypes::Snakes;
+    if(!params) {
+        int type = m_random.next() % 3;
+
+        if(!type)
+            m_fireworkType = FireworkTypes::Blinks;
+        else
+            m_fireworkType = FireworkTypes::Snakes;
+    }
 
     if(m_fireworkType == FireworkTypes::Blinks) {
         m_particlesMaxTail = 0;
@@ -47,12 +106,15 @@ Firework::Firework(int posX, int posY)
         m_particlesSize += 3.0f;
     }
 
+    if(m_budget)
+        m_rocketMaxTail = m_budget->requestRocketTail(m_rocketMaxTail);
+
     launchRocket();
 }
 
 void Firework::launchRocket()
 {
-    float verticalVelocity = 4.0f + ((float)qrand() / (float)RAND_MAX) * 2.0f;
+    float verticalVelocity = 4.0f + ((float)m_random.next() / (float)RAND_MAX) * 2.0f;
 
     m_rocket << Particle(m_mouseClickedPosition.x(), LAUNCH_POSITION_Y);
     m_rocket.last().setVelocity(0.0f, verticalVelocity);
@@ -63,22 +125,14 @@ void Firework::launchRocket()
 
 void Firework::moveRocket()
 {
+    TRACE_SCOPE("Firework::moveRocket");
+
     QVector2D position;
     GLColor color;
 
-    for(int i = 1; i < m_rocket.size(); ++i) {
-        color = m_rocket.at(i).getColor();
-        color.green -= (1.0 / (float)m_rocketMaxTail) * 1.3f;
-        color.alpha -= (1.0 / (float)m_rocketMaxTail);
-
-        if(color.alpha > 0.0)
-            m_rocket[i].setColor(color);
-        else {
-            m_rocket.removeAt(i);
-            --m_rocketCurrentTail;
-            --i;
-        }
-    }
+    // The head at index 0 does not fade
+    rocketTailAffectors(m_rocketMaxTail).update(m_rocket.data() + 1, m_rocket.data() + m_rocket.size());
+    m_rocketCurrentTail -= removeFaded(m_rocket, 1);
 
     position = m_rocket.first().getPosition();
 
@@ -92,7 +146,7 @@ void Firework::moveRocket()
     }
 
     m_mouseClickedPosition.setX(position.x());
-    m_rocket.first().setPosition(position.x() + (-0.75f + ((float)qrand() / (float)RAND_MAX) * 1.5f), position.y() + m_rocket.first().getVelocity().y());
+    m_rocket.first().setPosition(position.x() + (-0.75f + ((float)m_random.next() / (float)RAND_MAX) * 1.5f), position.y() + m_rocket.first().getVelocity().y());
 
     if (m_rocket.first().getPosition().y() >= m_mouseClickedPosition.y()) {
         m_rocket.removeFirst();
@@ -105,123 +159,85 @@ void Firework::moveRocket()
 
 void Firework::destroyRocketTail()
 {
-    GLColor color;
+    TRACE_SCOPE("Firework::destroyRocketTail");
 
-    for(int i = 0; i < m_rocket.size(); ++i) {
-        color = m_rocket.at(i).getColor();
-        color.green -= (1.0 / (float)m_rocketMaxTail) * 1.3f;
-        color.alpha -= (1.0 / (float)m_rocketMaxTail);
-
-        if(color.alpha > 0.0)
-            m_rocket[i].setColor(color);
-        else {
-            m_rocket.removeAt(i);
-            --m_rocketCurrentTail;
-            --i;
-        }
-    }
+    rocketTailAffectors(m_rocketMaxTail).update(m_rocket.data(), m_rocket.data() + m_rocket.size());
+    m_rocketCurrentTail -= removeFaded(m_rocket, 0);
 }
 
 void Firework::explodeFirework()
 {
-    GLColor particleColor = FIREWORK_COLORS[qrand() % FIREWORK_COLORS_SIZE];
-    m_explosionPosition = m_mouseClickedPosition;
-
-    if(m_fireworkType == FireworkTypes::Blinks) {
-        if(!(qrand() % 3))
-            particleColor = GLColor(1.0f, 1.0f, 1.0f, 0.0f);
-        else
-            particleColor.alpha = 0.0f;
-    }
-
-    uint size, particlesOnLevel;
-    float angle, speed, verticalVelocity, horizontalVelocity;
-
-    for (uint i = 0; i < m_fireworkLevel; ++i) {
+    TRACE_SCOPE("Firework::explodeFirework");
 
-        particlesOnLevel = 1 + 3 * i + (qrand() % 2) * i;
-        speed = (0.1f + (float)i) + ((float)qrand() / (float)RAND_MAX) * 0.1f;
-        size = m_particles.size();
-
-        for (uint j = 0; j < particlesOnLevel; ++j) {
-
-            m_particles << QVector<Particle>();
-            m_particles[j + size] << Particle();
-            m_particles[j + size][0].setPosition(m_mouseClickedPosition);
+    GLColor particleColor;
+    m_explosionPosition = m_mouseClickedPosition;
 
-            angle = (360.0f / particlesOnLevel) * (float)j + (360.0f / particlesOnLevel / 2.0f) * (i % 2) + m_particlesAngleOffset;
+    if(m_colorIndex < 0) {
+        particleColor = FIREWORK_COLORS[m_random.next() % FIREWORK_COLORS_SIZE];
 
-            horizontalVelocity = speed * cosf(angle / 180.0f * M_PI) * (1.0f + 0.2f * ((float)qrand() / (float)RAND_MAX));
-            verticalVelocity = speed * sinf(angle / 180.0f * M_PI) * (1.0f + 0.2f * ((float)qrand() / (float)RAND_MAX));
+        if(m_fireworkType == FireworkTypes::Blinks && !(m_random.next() % 3))
+            particleColor = GLColor(1.0f, 1.0f, 1.0f, 1.0f);
+    } else {
+        particleColor = (uint)m_colorIndex < FIREWORK_COLORS_SIZE ? FIREWORK_COLORS[m_colorIndex] : GLColor(1.0f, 1.0f, 1.0f, 1.0f);
+    }
 
-            if(fabs(horizontalVelocity) < 0.001)
-                horizontalVelocity = 0.0f;
+    // Blinks start invisible and light up while they flicker
+    if(m_fireworkType == FireworkTypes::Blinks)
+        particleColor.alpha = 0.0f;
 
-            if(fabs(verticalVelocity) < 0.001)
-                verticalVelocity = 0.0f;
+    // Rings and trail length are settled only now, the budget knows how many particles are alive at this moment
+    if(m_budget) {
+        ParticleAllowance allowance = m_budget->request(m_fireworkLevel, m_particlesMaxTail);
+        m_fireworkLevel = allowance.levels;
+        m_particlesMaxTail = allowance.maxTail;
+        m_particlesTailStride = allowance.tailStride;
+    }
 
+    RingEmitter(m_mouseClickedPosition, m_fireworkLevel, (float)m_particlesAngleOffset, particleColor).spawn(m_heads, m_random);
 
-            m_particles[j + size][0].setVelocity(verticalVelocity, horizontalVelocity);
+    // All trails share the color of the burst and keep a ring of m_particlesMaxTail past head positions
+    m_particlesColor = particleColor;
+    m_trailNodes.resize(m_heads.size() * m_particlesMaxTail);
+    m_trailNewest = 0;
+    m_trailFirstAge = 0;
 
-            m_particles[j + size][0].setColor(particleColor);
-        }
-    }
+    m_burstPending = true;
 
-    QSound::play(":/sounds/explosion.wav");
+    AudioEngine::instance().play(Sounds::Explosion);
 }
 
 void Firework::moveFireworkParticles()
 {
-    QVector2D position, velocity, originalPosition, originalVelocity;
-    GLColor color;
+    TRACE_SCOPE("Firework::moveFireworkParticles");
 
-    for (int i = 0; i < m_particles.size(); ++i) {
+    bool flicker = (m_fireworkType == FireworkTypes::Blinks) && (m_particlesFlightDuration < 60) && !(m_particlesFlightDuration % 5);
 
-        originalPosition = m_particles[i].last().getPosition();
-        originalVelocity = m_particles[i].last().getVelocity();
+    m_burstPending = false;
 
-        for(int j = 0; j < m_particles.at(i).size(); ++j) {
-            position = m_particles[i][j].getPosition();
-            velocity = m_particles[i][j].getVelocity();
-
-            if((position.y() + velocity.y()) >= LAUNCH_POSITION_Y)
-                m_particles[i][j].setPosition(position + velocity);
-            else
-                m_particles[i][j].setPosition(position.x() + velocity.x(), LAUNCH_POSITION_Y);
-
-            velocity.setX(velocity.x() * 0.96f);
-            velocity.setY(velocity.y() * 0.96f - GRAVITY);
-            m_particles[i][j].setVelocity(velocity);
-
-            if((m_fireworkType == FireworkTypes::Blinks) &&(m_particlesFlightDuration < 60) && !(m_particlesFlightDuration % 5)) {
-                color = m_particles[i].first().getColor();
-                color.alpha = (float)(qrand() % 2);
-                m_particles[i].first().setColor(color);
+    // The fizz belongs to the firework, it also plays when the particles are simulated elsewhere
+    if(flicker && !m_fizzPlayed) {
+        AudioEngine::instance().play(Sounds::Fizz);
+        m_fizzPlayed = true;
+    }
 
-                if(!m_fizzPlayed) {
-                    QSound::play(":/sounds/fizz.wav");
-                    m_fizzPlayed = true;
-                }
-            }
-        }
+    // Trail nodes repeat the path of their head a step later each, only the heads are moved
+    pushTrailHistory();
 
-        if(m_particlesCurrentTail < m_particlesMaxTail) {
-            color = m_particles[i].last().getColor();
+    // The chain is picked once per frame, the loop over the heads does not branch
+    Particle *heads = m_heads.data();
 
-            m_particles[i] << Particle(originalPosition.x(), originalPosition.y());
-            m_particles[i].last().setVelocity(originalVelocity);
-            color.alpha -= (1.0 / (float)m_particlesMaxTail);
-            m_particles[i].last().setColor(color);
-        }
-    }
+    if(flicker)
+        flickerAffectors(m_random).update(heads, heads + m_heads.size());
+    else
+        flightAffectors().update(heads, heads + m_heads.size());
 
     if(m_particlesCurrentTail < m_particlesMaxTail)
         ++m_particlesCurrentTail;
 
+    // The heads disappear but keep moving, the trails follow them until they fade
     if(!(--m_particlesFlightDuration))
     {
-        for (int i = 0; i < m_particles.size(); ++i)
-            m_particles[i].removeFirst();
+        m_trailFirstAge = 1;
 
         m_fireworkState = FireworkStates::Faded;
     }
@@ -232,30 +248,18 @@ void Firework::moveFireworkParticles()
 
 void Firework::destroyParticlesTails()
 {
-    QVector2D position, velocity;
-
-    for (int i = 0; i < m_particles.size(); ++i) {
+    TRACE_SCOPE("Firework::destroyParticlesTails");
 
-        for(int j = 0; j < m_particles[i].size(); ++j) {
-            position = m_particles[i][j].getPosition();
-            velocity = m_particles[i][j].getVelocity();
+    pushTrailHistory();
 
-            if((position.y() + velocity.y()) >= LAUNCH_POSITION_Y)
-                m_particles[i][j].setPosition(position + velocity);
-            else
-                m_particles[i][j].setPosition(position.x() + velocity.x(), LAUNCH_POSITION_Y);
-
-            velocity.setX(velocity.x() * 0.96f);
-            velocity.setY(velocity.y() * 0.96f - GRAVITY);
-            m_particles[i][j].setVelocity(velocity);
-        }
-
-        if(m_particlesCurrentTail)
-            m_particles[i].removeFirst();
-    }
+    Particle *heads = m_heads.data();
+    flightAffectors().update(heads, heads + m_heads.size());
 
-    if(m_particlesCurrentTail)
+    // The trail shortens from the head side, its end keeps the age it had
+    if(m_particlesCurrentTail) {
+        ++m_trailFirstAge;
         --m_particlesCurrentTail;
+    }
     else
         m_fireworkState = FireworkStates::Finished;
 
@@ -263,6 +267,35 @@ void Firework::destroyParticlesTails()
         ++m_curExplosionDuration;
 }
 
+void Firework::moveParticle(Particle &particle)
+{
+    // The transform feedback shader particlesim.vert repeats this step, both must stay identical
+    flightAffectors().apply(particle);
+}
+
+bool Firework::isBurstPending() const
+{
+    return m_burstPending;
+}
+
+ParticleSpan Firework::getBurst() const
+{
+    return ParticleSpan(m_heads.constData(), m_heads.size());
+}
+
+void Firework::detachParticles(bool detachExplosion)
+{
+    // The firework itself keeps running until its flight time is over, it only stops drawing what was detached
+    if(detachExplosion)
+        m_curExplosionDuration = EXPLOSION_DURATION;
+
+    m_heads.clear();
+    m_trailNodes.clear();
+    m_particlesCurrentTail = 0;
+    m_particlesMaxTail = 0;
+    m_burstPending = false;
+}
+
 FireworkStates Firework::getCurrentFireworkState() const
 {
     return m_fireworkState;
@@ -278,19 +311,14 @@ GLfloat Firework::getRocketSize() const
     return m_rocketSize;
 }
 
-GLColor Firework::getRocketColor(int index) const
+ParticleSpan Firework::getRocket() const
 {
-    return m_rocket.at(index).getColor();
-}
-
-QVector2D Firework::getRocketPosition(int index) const
-{
-    return m_rocket.at(index).getPosition();
+    return ParticleSpan(m_rocket.constData(), m_rocket.size());
 }
 
 uint Firework::getParticlesQuantity() const
 {
-    return m_particles.size();
+    return m_heads.size();
 }
 
 GLfloat Firework::getParticlesSize() const
@@ -298,9 +326,87 @@ GLfloat Firework::getParticlesSize() const
     return m_particlesSize;
 }
 
-QVector<Particle> Firework::getParticle(int index)
+uint Firework::getParticlesFlightDuration() const
+{
+    return m_particlesFlightDuration;
+}
+
+uint Firework::getParticlesMaxTail() const
+{
+    return m_particlesMaxTail;
+}
+
+uint Firework::getParticlesTailStride() const
+{
+    return m_particlesTailStride;
+}
+
+uint Firework::getLiveParticlesCount() const
 {
-    return m_particles.at(index);
+    return m_rocket.size() + m_heads.size() * getVisibleTrailSize();
+}
+
+TrailView Firework::getTrail(int index) const
+{
+    TrailView result;
+
+    result.m_head = &m_heads.at(index);
+    result.m_nodes = m_trailNodes.constData() + index * m_particlesMaxTail;
+    result.m_capacity = m_particlesMaxTail;
+    result.m_newest = m_trailNewest;
+    result.m_firstAge = m_trailFirstAge;
+    result.m_size = getVisibleTrailSize();
+    result.m_origin = m_explosionPosition;
+    result.m_color = m_particlesColor;
+    result.m_fade = m_particlesMaxTail ? 1.0f / (float)m_particlesMaxTail : 0.0f;
+
+    return result;
+}
+
+int Firework::getParticleSpritesCount(bool headsOnly) const
+{
+    int count = getVisibleTrailSize();
+
+    return m_heads.size() * (headsOnly ? qMin(count, 1) : count);
+}
+
+int Firework::writeRocketSprites(PointSpriteData *output) const
+{
+    // Rockets are anchored at their lower left corner, sprites are centered, so the rocket quad is shifted by half its size
+    QVector2D size(m_rocketSize / 2.0f, m_rocketSize * 2.0f);
+    QVector2D offset = size / 2.0f;
+
+    for (int i = 0; i < m_rocket.size(); ++i)
+        output[i] = PointSpriteData(m_rocket.at(i).getPosition() + offset, size, 0.0f, m_rocket.at(i).getColor());
+
+    return m_rocket.size();
+}
+
+int Firework::writeParticleSprites(PointSpriteData *output, bool headsOnly) const
+{
+    QVector2D size(m_particlesSize, m_particlesSize);
+    bool rotated = (m_fireworkType != FireworkTypes::Blinks);
+    int count = getVisibleTrailSize();
+    int written = 0;
+
+    if(headsOnly)
+        count = qMin(count, 1);
+
+    for (int i = 0; i < m_heads.size(); ++i) {
+
+        TrailView trail = getTrail(i);
+
+        for (int k = 0; k < count; ++k) {
+
+            // The sprite is turned so that its vertical axis follows the velocity, blinks are not rotated
+            QVector2D velocity = rotated ? trail.velocity(k) : QVector2D();
+            GLfloat angle = rotated ? atan2(-velocity.x(), velocity.y()) : 0.0f;
+
+            output[written++] = PointSpriteData(trail.position(k), size, angle, trail.color(k));
+        }
+    }
+
+    return written;
 }
 
 QVector2D Firework::getExplosionPosition() const
@@ -323,6 +429,44 @@ FireworkTypes Firework::getType() const
     return m_fireworkType;
 }
 
+void Firework::pushTrailHistory()
+{
+    if(!m_particlesMaxTail)
+        return;
+
+    // 16-bit offsets in 1/8 pixel reach 4096 pixels from the explosion, further nodes stick to the edge of that range
+    m_trailNewest = (m_trailNewest + 1) % m_particlesMaxTail;
+
+    QVector2D offset;
+    TrailNode *node = m_trailNodes.data() + m_trailNewest;
+
+    for (int i = 0; i < m_heads.size(); ++i, node += m_particlesMaxTail) {
+        offset = (m_heads.at(i).getPosition() - m_explosionPosition) * (float)TrailNode::SCALE;
+
+        node->x = (qint16)qBound(-32768, qRound(offset.x()), 32767);
+        node->y = (qint16)qBound(-32768, qRound(offset.y()), 32767);
+    }
+}
+
+int Firework::getVisibleTrailSize() const
+{
+    // The head counts while it flies, after that only the nodes that have not faded yet
+    return m_particlesCurrentTail + (m_trailFirstAge ? 0 : 1);
+}
+
+int FireworkRandom::next()
+{
+    if(!m_state)
+        return qrand();
+
+    // xorshift32 in the range of qrand(), a seeded firework draws the same numbers whatever else is launched
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+
+    return int(quint64(m_state) * RAND_MAX / 0xFFFFFFFFu);
+}
+
 Particle::Particle(float posX, float posY)
     : m_position(posX, posY)
 {
@@ -350,21 +494,6 @@ void Particle::setVelocity(const QVector2D &velocity)
     setVelocity(velocity.x(), velocity.y());
 }
 
-QVector2D Particle::getPosition() const
-{
-    return m_position;
-}
-
-QVector2D Particle::getVelocity() const
-{
-    return m_velocity;
-}
-
-GLColor Particle::getColor() const
-{
-    return m_color;
-}
-
 void Particle::setColor(const GLColor &color)
 {
     m_color = color;
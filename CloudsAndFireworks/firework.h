@@ -2,11 +2,13 @@
 #define FIREWORK_H
 
 #include "resourcemanager.h"
+#include "particlebudget.h"
 
 enum class FireworkTypes
 {
     Blinks,
-    Snakes
+    Snakes,
+    Count
 };
 
 enum class FireworkStates
@@ -21,7 +23,41 @@ enum class FireworkModes
 {
     Explosion,
     Blinks,
-    Snakes
+    Snakes,
+    Ribbons
+};
+
+/*!
+  Параметры фейерверка, заданные сценарием шоу. Цвета за пределами палитры дают белый.
+  Колец от 1 до MAX_LEVEL, как у случайного фейерверка. Ненулевое зерно делает фейерверк независимым от qrand() и от других фейерверков.
+  */
+struct FireworkParams
+{
+    static const uint MAX_LEVEL = 7;
+
+    FireworkTypes type;
+    uint level;
+    uint color;
+    quint32 seed;
+
+    FireworkParams(FireworkTypes type = FireworkTypes::Snakes, uint level = 4, uint color = 0, quint32 seed = 0)
+        : type(type)
+        , level(level)
+        , color(color)
+        , seed(seed) {}
+};
+
+/*! Случайные числа фейерверка в диапазоне qrand(). С ненулевым зерном - свой xorshift32, иначе qrand(). */
+class FireworkRandom
+{
+public:
+    explicit FireworkRandom(quint32 seed = 0)
+        : m_state(seed) {}
+
+    int next();
+
+private:
+    quint32 m_state;
 };
 
 class Particle
@@ -29,15 +65,15 @@ class Particle
 public:
     Particle(float posX = 0.0f, float posY = 0.0f);
 
-    QVector2D getPosition() const;
+    const QVector2D &getPosition() const { return m_position; }
     void setPosition(float posX, float posY);
     void setPosition(const QVector2D &position);
 
-    QVector2D getVelocity() const;
+    const QVector2D &getVelocity() const { return m_velocity; }
     void setVelocity(float velX, float velY);
     void setVelocity(const QVector2D &velocity);
 
-    GLColor getColor() const;
+    const GLColor &getColor() const { return m_color; }
     void setColor(const GLColor &color);
 
 private:
@@ -46,10 +82,119 @@ private:
     GLColor m_color;
 };
 
+/*! Частицы фейерверка только для чтения, без копирования. Действительны, пока фейерверк не сдвинут и не изменён. */
+class ParticleSpan
+{
+public:
+    ParticleSpan(const Particle *data = NULL, int size = 0)
+        : m_data(data)
+        , m_size(size) {}
+
+    const Particle *begin() const { return m_data; }
+    const Particle *end() const { return m_data + m_size; }
+
+    const Particle &at(int index) const { return m_data[index]; }
+    const Particle &operator[](int index) const { return m_data[index]; }
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return !m_size; }
+
+private:
+    const Particle *m_data;
+    int m_size;
+};
+
+/*! Узел истории следа: положение в 1/SCALE пикселя относительно точки взрыва. */
+struct TrailNode
+{
+    static const int SCALE = 8;
+
+    qint16 x;
+    qint16 y;
+};
+
+/*!
+  @brief След частицы фейерверка только для чтения.
+
+  Узлы идут от головы к концу хвоста. Их положения раскодируются из истории головы,
+  цвет - общий цвет следа с прозрачностью по возрасту узла. Действителен, пока фейерверк не сдвинут и не изменён.
+  */
+
+
+class TrailView
+{
+public:
+    int size() const { return m_size; }
+    bool isEmpty() const { return !m_size; }
+
+    QVector2D position(int index) const { return positionAt(m_firstAge + index); }
+    QVector2D velocity(int index) const;
+    GLColor color(int index) const;
+
+private:
+    friend class Firework;
+
+    TrailView()
+        : m_head(NULL)
+        , m_nodes(NULL)
+        , m_capacity(0)
+        , m_newest(0)
+        , m_firstAge(0)
+        , m_size(0)
+        , m_fade(0.0f) {}
+
+    QVector2D positionAt(int age) const;
+
+    const Particle *m_head;
+    const TrailNode *m_nodes;
+    int m_capacity;
+    int m_newest;
+    int m_firstAge;
+    int m_size;
+    QVector2D m_origin;
+    GLColor m_color;
+    GLfloat m_fade;
+};
+
+inline QVector2D TrailView::positionAt(int age) const
+{
+    if(!age)
+        return m_head->getPosition();
+
+    // The newest node holds the head position of the previous step, older ones follow it around the ring
+    const TrailNode &node = m_nodes[(m_newest - age + 1 + m_capacity) % m_capacity];
+
+    return m_origin + QVector2D(node.x, node.y) / (float)TrailNode::SCALE;
+}
+
+inline QVector2D TrailView::velocity(int index) const
+{
+    int age = m_firstAge + index;
+
+    // Every node repeats the path of the head, so its velocity is the step to the next younger node
+    if(!age)
+        return m_head->getVelocity();
+
+    return positionAt(age - 1) - positionAt(age);
+}
+
+inline GLColor TrailView::color(int index) const
+{
+    int age = m_firstAge + index;
+
+    if(!age)
+        return m_head->getColor();
+
+    GLColor result = m_color;
+    result.alpha -= m_fade * (float)age;
+
+    return result;
+}
+
 class Firework
 {
 public:
-    Firework(int posX = 0, int posY = 0);
+    Firework(int posX = 0, int posY = 0, ParticleBudget *budget = NULL, const FireworkParams *params = NULL);
     void launchRocket();
     void moveRocket();
     void destroyRocketTail();
@@ -57,16 +202,38 @@ public:
     void moveFireworkParticles();
     void destroyParticlesTails();
 
+    static void moveParticle(Particle &particle);
+
+    static const float GRAVITY;
+    static const float DAMPING;
+    static const float LAUNCH_POSITION_Y;
+
+    bool isBurstPending() const;
+    ParticleSpan getBurst() const;
+    void detachParticles(bool detachExplosion = false);
+
     FireworkStates getCurrentFireworkState() const;
 
     uint getRocketParticlesQuantity() const;
     GLfloat getRocketSize() const;
-    GLColor getRocketColor(int index) const;
-    QVector2D getRocketPosition(int index) const;
+    ParticleSpan getRocket() const;
 
     uint getParticlesQuantity() const;
     GLfloat getParticlesSize() const;
-    QVector<Particle> getParticle(int index);
+    uint getParticlesFlightDuration() const;
+    uint getParticlesMaxTail() const;
+    uint getParticlesTailStride() const;
+    uint getLiveParticlesCount() const;
+    TrailView getTrail(int index) const;
+
+    /*! Возвращает количество спрайтов, которое запишет writeParticleSprites(). */
+    int getParticleSpritesCount(bool headsOnly) const;
+
+    /*! Записывает спрайты ракеты в <i>output</i>, места должно хватать на getRocketParticlesQuantity(). Возвращает их количество. */
+    int writeRocketSprites(PointSpriteData *output) const;
+
+    /*! Записывает спрайты частиц, с <i>headsOnly</i> только голов следов, в <i>output</i>. Возвращает их количество. */
+    int writeParticleSprites(PointSpriteData *output, bool headsOnly) const;
 
     QVector2D getExplosionPosition() const;
     QVector2D calculateSpriteOffset() const;
@@ -75,9 +242,14 @@ public:
     FireworkTypes getType() const;
 
 private:
+    void pushTrailHistory();
+    int getVisibleTrailSize() const;
+
+    ParticleBudget *m_budget;
     QVector2D m_mouseClickedPosition;
     FireworkTypes m_fireworkType;
     bool m_fizzPlayed;
+    bool m_burstPending;
     FireworkStates m_fireworkState;
     uint m_fireworkLevel;
 
@@ -86,18 +258,24 @@ private:
     uint m_rocketMaxTail;
     uint m_rocketCurrentTail;
 
-    QVector< QVector<Particle> > m_particles;
+    QVector<Particle> m_heads;
+    QVector<TrailNode> m_trailNodes;
+    GLColor m_particlesColor;
+    int m_trailNewest;
+    uint m_trailFirstAge;
     GLfloat m_particlesSize;
     uint m_particlesAngleOffset;
     uint m_particlesFlightDuration;
     uint m_particlesMaxTail;
     uint m_particlesCurrentTail;
+    uint m_particlesTailStride;
 
     uint m_curExplosionDuration;
     QVector2D m_explosionPosition;
 
-    static const float GRAVITY;
-    static const float LAUNCH_POSITION_Y;
+    int m_colorIndex;
+    FireworkRandom m_random;
+
     static const GLColor FIREWORK_COLORS[];
     static const uint FIREWORK_COLORS_SIZE;
     static const uint EXPLOSION_DURATION;
@@ -0,0 +1,355 @@
+#include "framecapture.h"
+#include "tracer.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QFile>
+#include <QtDebug>
+#include <cstdio>
+#include <cstring>
+
+/*!
+  @brief Поток записи кадров.
+
+  Получает кадры из очереди, переворачивает их по вертикали, при необходимости переводит в YUV 4:2:0 и пишет в файл.
+  */
+
+
+class CaptureWriter : public QThread
+{
+public:
+    CaptureWriter(QFile *file, CaptureFormats format, uint width, uint height, uint framesPerSecond);
+    ~CaptureWriter();
+
+    QByteArray acquireBuffer();
+    bool enqueue(QByteArray frame, bool wait);
+    void finish();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void writeRgba(const QByteArray &frame);
+    void writeY4m(const QByteArray &frame);
+
+    static const int MAX_QUEUED_FRAMES = 8;
+
+    QFile *m_file;
+    CaptureFormats m_format;
+    uint m_width;
+    uint m_height;
+    uint m_framesPerSecond;
+
+    QMutex m_mutex;
+    QWaitCondition m_frameQueued;
+    QWaitCondition m_frameTaken;
+    QQueue<QByteArray> m_queue;
+    QVector<QByteArray> m_freeBuffers;
+    bool m_finishing;
+
+    QByteArray m_planes;
+};
+
+CaptureWriter::CaptureWriter(QFile *file, CaptureFormats format, uint width, uint height, uint framesPerSecond)
+    : m_file(file)
+    , m_format(format)
+    , m_width(width)
+    , m_height(height)
+    , m_framesPerSecond(framesPerSecond)
+    , m_finishing(false)
+{
+    setObjectName(QStringLiteral("CaptureWriter"));
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    finish();
+    delete m_file;
+}
+
+QByteArray CaptureWriter::acquireBuffer()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if(!m_freeBuffers.isEmpty()) {
+        QByteArray buffer = m_freeBuffers.last();
+        m_freeBuffers.removeLast();
+        return buffer;
+    }
+
+    return QByteArray(m_width * m_height * 4, Qt::Uninitialized);
+}
+
+bool CaptureWriter::enqueue(QByteArray frame, bool wait)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while(m_queue.size() >= MAX_QUEUED_FRAMES) {
+        if(!wait) {
+            m_freeBuffers << frame;
+            return false;
+        }
+        m_frameTaken.wait(&m_mutex);
+    }
+
+    m_queue.enqueue(frame);
+    m_frameQueued.wakeOne();
+
+    return true;
+}
+
+void CaptureWriter::finish()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_finishing = true;
+        m_frameQueued.wakeOne();
+    }
+
+    wait();
+}
+
+void CaptureWriter::run()
+{
+    TRACE_SCOPE("CaptureWriter::run");
+
+    if(m_format == CaptureFormats::Y4m) {
+        m_file->write(QStringLiteral("YUV4MPEG2 W%1 H%2 F%3:1 Ip A1:1 C420jpeg\n")
+                      .arg(m_width).arg(m_height).arg(m_framesPerSecond).toLatin1());
+    }
+
+    QByteArray frame;
+
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+
+            while(m_queue.isEmpty() && !m_finishing)
+                m_frameQueued.wait(&m_mutex);
+
+            if(m_queue.isEmpty())
+                break;
+
+            frame = m_queue.dequeue();
+            m_frameTaken.wakeAll();
+        }
+
+        if(m_format == CaptureFormats::Y4m)
+            writeY4m(frame);
+        else
+            writeRgba(frame);
+
+        {
+            // The buffer is handed back only after the local reference is dropped, so that reusing it never detaches
+            QMutexLocker locker(&m_mutex);
+            m_freeBuffers << frame;
+            frame.clear();
+        }
+    }
+
+    m_file->flush();
+}
+
+void CaptureWriter::writeRgba(const QByteArray &frame)
+{
+    const int stride = m_width * 4;
+
+    // OpenGL rows go from the bottom up
+    for(int y = m_height - 1; y >= 0; --y)
+        m_file->write(frame.constData() + y * stride, stride);
+}
+
+void CaptureWriter::writeY4m(const QByteArray &frame)
+{
+    const uint chromaWidth = (m_width + 1) / 2;
+    const uint chromaHeight = (m_height + 1) / 2;
+    const uint lumaSize = m_width * m_height;
+    const uint chromaSize = chromaWidth * chromaHeight;
+
+    if(m_planes.size() != int(lumaSize + 2 * chromaSize))
+        m_planes.resize(lumaSize + 2 * chromaSize);
+
+    const uchar *pixels = (const uchar *)frame.constData();
+    uchar *luma = (uchar *)m_planes.data();
+    uchar *cb = luma + lumaSize;
+    uchar *cr = cb + chromaSize;
+
+    // Full range BT.601 as required by C420jpeg
+    for(uint y = 0; y < m_height; ++y) {
+        const uchar *row = pixels + (m_height - 1 - y) * m_width * 4;
+
+        for(uint x = 0; x < m_width; ++x) {
+            const uchar *pixel = row + x * 4;
+            luma[y * m_width + x] = uchar(0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2] + 0.5f);
+        }
+    }
+
+    for(uint y = 0; y < chromaHeight; ++y) {
+        uint y0 = qMin(2 * y, m_height - 1), y1 = qMin(2 * y + 1, m_height - 1);
+        const uchar *row0 = pixels + (m_height - 1 - y0) * m_width * 4;
+        const uchar *row1 = pixels + (m_height - 1 - y1) * m_width * 4;
+
+        for(uint x = 0; x < chromaWidth; ++x) {
+            uint x0 = qMin(2 * x, m_width - 1) * 4, x1 = qMin(2 * x + 1, m_width - 1) * 4;
+
+            float red = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+            float green = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1]) * 0.25f;
+            float blue = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2]) * 0.25f;
+
+            cb[y * chromaWidth + x] = uchar(qBound(0.0f, 128.0f - 0.168736f * red - 0.331264f * green + 0.5f * blue + 0.5f, 255.0f));
+            cr[y * chromaWidth + x] = uchar(qBound(0.0f, 128.0f + 0.5f * red - 0.418688f * green - 0.081312f * blue + 0.5f, 255.0f));
+        }
+    }
+
+    m_file->write("FRAME\n", 6);
+    m_file->write(m_planes);
+}
+
+FrameCapture::FrameCapture()
+    : m_active(false)
+    , m_width(0)
+    , m_height(0)
+    , m_frameSize(0)
+    , m_frameIndex(0)
+    , m_droppedFrames(0)
+    , m_writer(NULL)
+{
+    for(int i = 0; i < PBO_COUNT; ++i)
+        m_pbos[i] = 0;
+}
+
+FrameCapture::~FrameCapture()
+{
+    if(!m_active)
+        return;
+
+    // Without the state cache the ring cannot be read back, the frames still in it are lost
+    qWarning() << QStringLiteral("FrameCapture: destroyed while recording, the last frames are lost!");
+
+    delete m_writer;
+    glDeleteBuffers(PBO_COUNT, m_pbos);
+}
+
+bool FrameCapture::start(const QString &fileName, CaptureFormats format, uint width, uint height, GLStateCache &state, uint framesPerSecond)
+{
+    if(m_active)
+        stop(state);
+
+    if(!initializeOpenGLFunctions())
+        return false;
+
+    QFile *file = new QFile(fileName);
+    bool opened = (fileName == QStringLiteral("-")) ? file->open(stdout, QIODevice::WriteOnly)
+                                                    : file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+    if(!opened) {
+        qWarning() << QStringLiteral("FrameCapture: failed to open '") + fileName + QStringLiteral("'!");
+        delete file;
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_frameSize = width * height * 4;
+    m_frameIndex = 0;
+    m_droppedFrames = 0;
+
+    glGenBuffers(PBO_COUNT, m_pbos);
+    for(int i = 0; i < PBO_COUNT; ++i) {
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, m_frameSize, NULL, GL_STREAM_READ);
+    }
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_writer = new CaptureWriter(file, format, width, height, framesPerSecond);
+    m_writer->start();
+
+    m_active = true;
+
+    qDebug() << QStringLiteral("FrameCapture: recording to '") + fileName + QStringLiteral("'.");
+
+    return true;
+}
+
+void FrameCapture::stop(GLStateCache &state)
+{
+    if(!m_active)
+        return;
+
+    // Frames N-2 and N-1 are still in the ring
+    quint64 first = m_frameIndex > PBO_COUNT - 1 ? m_frameIndex - (PBO_COUNT - 1) : 0;
+    for(quint64 i = first; i < m_frameIndex; ++i) {
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i % PBO_COUNT]);
+        mapFrame(i % PBO_COUNT, true);
+    }
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    delete m_writer;
+    m_writer = NULL;
+
+    glDeleteBuffers(PBO_COUNT, m_pbos);
+    for(int i = 0; i < PBO_COUNT; ++i)
+        m_pbos[i] = 0;
+
+    m_active = false;
+
+    qDebug() << QStringLiteral("FrameCapture: recorded") << m_frameIndex - m_droppedFrames << QStringLiteral("frames, dropped") << m_droppedFrames;
+}
+
+void FrameCapture::captureFrame(GLuint framebuffer, GLStateCache &state)
+{
+    if(!m_active)
+        return;
+
+    TRACE_SCOPE("FrameCapture::captureFrame");
+
+    state.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[m_frameIndex % PBO_COUNT]);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+    // The readback of frame N-2 has had two frames to complete, so mapping it does not stall
+    if(m_frameIndex >= PBO_COUNT - 1) {
+        int slot = (m_frameIndex + 1) % PBO_COUNT;
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+        mapFrame(slot, false);
+    }
+
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    ++m_frameIndex;
+}
+
+void FrameCapture::mapFrame(int slot, bool wait)
+{
+    const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_frameSize, GL_MAP_READ_BIT);
+
+    if(!data) {
+        ++m_droppedFrames;
+        return;
+    }
+
+    QByteArray frame = m_writer->acquireBuffer();
+    memcpy(frame.data(), data, m_frameSize);
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+    // The render loop never waits for the disk: when the writer falls behind, frames are dropped
+    if(!m_writer->enqueue(frame, wait))
+        ++m_droppedFrames;
+}
+
+bool FrameCapture::isActive() const
+{
+    return m_active;
+}
+
+qint64 FrameCapture::bufferBytes() const
+{
+    return m_active ? qint64(PBO_COUNT) * m_frameSize : 0;
+}
+
+CaptureFormats FrameCapture::formatFromFileName(const QString &fileName)
+{
+    return fileName.endsWith(QStringLiteral(".y4m"), Qt::CaseInsensitive) ? CaptureFormats::Y4m : CaptureFormats::Rgba;
+}
@@ -0,0 +1,72 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include "glstatecache.h"
+
+enum class CaptureFormats
+{
+    Rgba,
+    Y4m
+};
+
+class CaptureWriter;
+
+/*!
+  @brief Класс записи кадров в видеопоток.
+
+  Читает готовые кадры через кольцо pixel buffer objects: кадр N-2 отображается в память, пока рисуется кадр N.
+  Кадры записываются в файл или канал отдельным потоком в формате raw RGBA или Y4M.
+  */
+
+
+class FrameCapture: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса FrameCapture. */
+    FrameCapture();
+
+    /*! Деструктор класса FrameCapture. Вызывать при активном контексте после stop(), иначе последние кадры теряются! */
+    ~FrameCapture();
+
+    /*!
+     * Начинает запись кадров размера <i>width</i> x <i>height</i> в файл <i>fileName</i> ("-" - стандартный вывод)
+     * в формате <i>format</i>. Возвращает <i>true</i> при успешном запуске. Привязки меняются через <i>state</i>.
+     * Не вызывать до создания контекста!
+     */
+    bool start(const QString &fileName, CaptureFormats format, uint width, uint height, GLStateCache &state, uint framesPerSecond = 60);
+
+    /*! Дописывает кадры, ещё находящиеся в кольце, и останавливает запись. Привязки меняются через <i>state</i>. */
+    void stop(GLStateCache &state);
+
+    /*! Запускает чтение готового кадра из фреймбуффера <i>framebuffer</i>. Привязки меняются через <i>state</i>. */
+    void captureFrame(GLuint framebuffer, GLStateCache &state);
+
+    /*! Возвращает <i>true</i>, если идёт запись. */
+    bool isActive() const;
+
+    /*! Возвращает объём видеопамяти, занятый буфферами чтения. */
+    qint64 bufferBytes() const;
+
+    /*! Возвращает формат по расширению файла <i>fileName</i>. */
+    static CaptureFormats formatFromFileName(const QString &fileName);
+
+private:
+    void mapFrame(int slot, bool wait);
+
+    static const int PBO_COUNT = 3;
+
+    bool m_active;
+    uint m_width;
+    uint m_height;
+    int m_frameSize;
+    quint64 m_frameIndex;
+    quint64 m_droppedFrames;
+
+    GLuint m_pbos[PBO_COUNT];
+    CaptureWriter *m_writer;
+};
+
+#endif // FRAMECAPTURE_H
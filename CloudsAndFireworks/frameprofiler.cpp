@@ -0,0 +1,322 @@
+#include "frameprofiler.h"
+#include <QFile>
+#include <QTextStream>
+#include <QOpenGLContext>
+#include <QtDebug>
+
+FrameProfiler::FrameProfiler()
+    : m_initialized(false)
+    , m_frameCount(0)
+    , m_currentSlot(0)
+    , m_activePass(-1)
+    , m_historyStart(0)
+    , m_totalFrames(0)
+    , m_droppedFrames(0)
+    , m_recording(false)
+{
+    for(int i = 0; i < FRAME_LATENCY; ++i) {
+        m_slotPending[i] = false;
+        for(int j = 0; j < PASS_COUNT; ++j) {
+            m_queries[i][j] = 0;
+            m_queryIssued[i][j] = false;
+        }
+    }
+
+    m_history.reserve(HISTORY_SIZE);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if(m_initialized && QOpenGLContext::currentContext())
+        glDeleteQueries(FRAME_LATENCY * PASS_COUNT, &m_queries[0][0]);
+}
+
+bool FrameProfiler::init()
+{
+    if(m_initialized)
+        return true;
+
+    if(!initializeOpenGLFunctions())
+        return false;
+
+    glGenQueries(FRAME_LATENCY * PASS_COUNT, &m_queries[0][0]);
+    m_initialized = true;
+
+    return true;
+}
+
+void FrameProfiler::beginFrame()
+{
+    if(!m_initialized)
+        return;
+
+    collectResults(false);
+
+    m_currentSlot = m_frameCount % FRAME_LATENCY;
+
+    // Results that are still not available after FRAME_LATENCY frames are dropped
+    // instead of stalling the pipeline. Only the first drop is logged, a GPU that falls behind drops every frame.
+    if(m_slotPending[m_currentSlot]) {
+        if(!m_droppedFrames)
+            qWarning() << QStringLiteral("FrameProfiler: dropped GPU timings of frame") << m_slotTimings[m_currentSlot].frame
+                       << QStringLiteral(", further drops are only counted.");
+
+        ++m_droppedFrames;
+    }
+
+    m_slotPending[m_currentSlot] = false;
+    m_slotTimings[m_currentSlot] = FrameTimings();
+    m_slotTimings[m_currentSlot].frame = m_frameCount;
+    for(int i = 0; i < PASS_COUNT; ++i)
+        m_queryIssued[m_currentSlot][i] = false;
+
+    m_frameTimer.start();
+}
+
+void FrameProfiler::endFrame()
+{
+    if(!m_initialized)
+        return;
+
+    if(m_activePass >= 0)
+        endPass();
+
+    m_slotTimings[m_currentSlot].cpuFrameMs = m_frameTimer.nsecsElapsed() / 1000000.0;
+    m_slotPending[m_currentSlot] = true;
+
+    ++m_frameCount;
+}
+
+void FrameProfiler::beginPass(ProfilerPasses pass)
+{
+    if(!m_initialized)
+        return;
+
+    if(m_activePass >= 0)
+        endPass();
+
+    m_activePass = (int)pass;
+    m_queryIssued[m_currentSlot][m_activePass] = true;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_currentSlot][m_activePass]);
+    m_passTimer.start();
+}
+
+void FrameProfiler::endPass()
+{
+    if(!m_initialized || m_activePass < 0)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_slotTimings[m_currentSlot].passes[m_activePass].cpuMs += m_passTimer.nsecsElapsed() / 1000000.0;
+    m_activePass = -1;
+}
+
+void FrameProfiler::finish()
+{
+    if(!m_initialized)
+        return;
+
+    collectResults(true);
+}
+
+void FrameProfiler::collectResults(bool wait)
+{
+    // Slots are checked from the oldest frame to the newest, queries complete in order.
+    for(int i = 0; i < FRAME_LATENCY; ++i) {
+        int slot = (m_frameCount + i) % FRAME_LATENCY;
+
+        if(!m_slotPending[slot])
+            continue;
+
+        int lastIssued = -1;
+        for(int j = 0; j < PASS_COUNT; ++j) {
+            if(m_queryIssued[slot][j])
+                lastIssued = j;
+        }
+
+        if(lastIssued >= 0 && !wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(m_queries[slot][lastIssued], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+                break;
+        }
+
+        FrameTimings &timings = m_slotTimings[slot];
+        GLuint64 elapsed;
+
+        for(int j = 0; j < PASS_COUNT; ++j) {
+            if(!m_queryIssued[slot][j])
+                continue;
+
+            elapsed = 0;
+            glGetQueryObjectui64v(m_queries[slot][j], GL_QUERY_RESULT, &elapsed);
+            timings.passes[j].gpuMs = elapsed / 1000000.0;
+            timings.gpuFrameMs += timings.passes[j].gpuMs;
+        }
+
+        m_slotPending[slot] = false;
+        pushHistory(timings);
+    }
+}
+
+void FrameProfiler::pushHistory(const FrameTimings &timings)
+{
+    if(m_history.size() < HISTORY_SIZE) {
+        m_history << timings;
+    } else {
+        m_history[m_historyStart] = timings;
+        m_historyStart = (m_historyStart + 1) % HISTORY_SIZE;
+    }
+
+    m_latest = timings;
+
+    if(m_recording)
+        m_recorded << timings;
+
+    m_totals.cpuFrameMs += timings.cpuFrameMs;
+    m_totals.gpuFrameMs += timings.gpuFrameMs;
+    for(int j = 0; j < PASS_COUNT; ++j) {
+        m_totals.passes[j].cpuMs += timings.passes[j].cpuMs;
+        m_totals.passes[j].gpuMs += timings.passes[j].gpuMs;
+    }
+    ++m_totalFrames;
+}
+
+QString FrameProfiler::passName(ProfilerPasses pass)
+{
+    switch(pass) {
+    case ProfilerPasses::Background:
+        return QStringLiteral("Background");
+    case ProfilerPasses::Fireworks:
+        return QStringLiteral("Fireworks");
+    case ProfilerPasses::CloudsFbo:
+        return QStringLiteral("CloudsFbo");
+    case ProfilerPasses::Composite:
+        return QStringLiteral("Composite");
+    case ProfilerPasses::Water:
+        return QStringLiteral("Water");
+    default:
+        return QString();
+    }
+}
+
+const FrameTimings &FrameProfiler::latest() const
+{
+    return m_latest;
+}
+
+FrameTimings FrameProfiler::average(int frames) const
+{
+    FrameTimings result;
+    int count = qMin(frames, m_history.size());
+
+    if(!count)
+        return result;
+
+    for(int i = 0; i < count; ++i) {
+        const FrameTimings &timings = m_history.at((m_historyStart + m_history.size() - 1 - i) % m_history.size());
+
+        result.cpuFrameMs += timings.cpuFrameMs;
+        result.gpuFrameMs += timings.gpuFrameMs;
+        for(int j = 0; j < PASS_COUNT; ++j) {
+            result.passes[j].cpuMs += timings.passes[j].cpuMs;
+            result.passes[j].gpuMs += timings.passes[j].gpuMs;
+        }
+    }
+
+    result.frame = m_latest.frame;
+    result.cpuFrameMs /= count;
+    result.gpuFrameMs /= count;
+    for(int j = 0; j < PASS_COUNT; ++j) {
+        result.passes[j].cpuMs /= count;
+        result.passes[j].gpuMs /= count;
+    }
+
+    return result;
+}
+
+FrameTimings FrameProfiler::totalAverage() const
+{
+    FrameTimings result = m_totals;
+
+    if(!m_totalFrames)
+        return result;
+
+    result.frame = m_latest.frame;
+    result.cpuFrameMs /= m_totalFrames;
+    result.gpuFrameMs /= m_totalFrames;
+    for(int j = 0; j < PASS_COUNT; ++j) {
+        result.passes[j].cpuMs /= m_totalFrames;
+        result.passes[j].gpuMs /= m_totalFrames;
+    }
+
+    return result;
+}
+
+void FrameProfiler::resetTotals()
+{
+    m_totals = FrameTimings();
+    m_totalFrames = 0;
+}
+
+quint64 FrameProfiler::droppedFrames() const
+{
+    return m_droppedFrames;
+}
+
+QVector<FrameTimings> FrameProfiler::history() const
+{
+    QVector<FrameTimings> result;
+    result.reserve(m_history.size());
+
+    for(int i = 0; i < m_history.size(); ++i)
+        result << m_history.at((m_historyStart + i) % m_history.size());
+
+    return result;
+}
+
+bool FrameProfiler::exportCsv(const QString &fileName) const
+{
+    return writeCsv(fileName, history());
+}
+
+void FrameProfiler::setRecording(bool enabled)
+{
+    m_recording = enabled;
+
+    if(!enabled)
+        m_recorded.clear();
+}
+
+const QVector<FrameTimings> &FrameProfiler::recorded() const
+{
+    return m_recorded;
+}
+
+bool FrameProfiler::writeCsv(const QString &fileName, const QVector<FrameTimings> &frames)
+{
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        qWarning() << QStringLiteral("FrameProfiler: failed to open '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    QTextStream stream(&file);
+
+    stream << "frame,cpu_frame_ms,gpu_frame_ms";
+    for(int j = 0; j < PASS_COUNT; ++j)
+        stream << ',' << passName((ProfilerPasses)j) << "_cpu_ms," << passName((ProfilerPasses)j) << "_gpu_ms";
+    stream << '\n';
+
+    for(int i = 0; i < frames.size(); ++i) {
+        stream << frames.at(i).frame << ',' << frames.at(i).cpuFrameMs << ',' << frames.at(i).gpuFrameMs;
+        for(int j = 0; j < PASS_COUNT; ++j)
+            stream << ',' << frames.at(i).passes[j].cpuMs << ',' << frames.at(i).passes[j].gpuMs;
+        stream << '\n';
+    }
+
+    qDebug() << QStringLiteral("FrameProfiler: exported") << frames.size() << QStringLiteral("frames to '") + fileName + QStringLiteral("'.");
+
+    return true;
+}
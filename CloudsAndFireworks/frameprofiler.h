@@ -0,0 +1,144 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QString>
+
+enum class ProfilerPasses
+{
+    Background,
+    Fireworks,
+    CloudsFbo,
+    Composite,
+    Water,
+    Count
+};
+
+struct PassTimings
+{
+    double cpuMs;
+    double gpuMs;
+
+    PassTimings(double cpuMs = 0.0, double gpuMs = 0.0)
+        : cpuMs(cpuMs)
+        , gpuMs(gpuMs) {}
+};
+
+struct FrameTimings
+{
+    quint64 frame;
+    double cpuFrameMs;
+    double gpuFrameMs;
+    PassTimings passes[(int)ProfilerPasses::Count];
+
+    FrameTimings()
+        : frame(0)
+        , cpuFrameMs(0.0)
+        , gpuFrameMs(0.0) {}
+};
+
+/*!
+  @brief Класс профайлера кадра.
+
+  Замеряет время каждого прохода отрисовки на GPU (запросы GL_TIME_ELAPSED) и на CPU.
+  Результаты GPU забираются без ожидания, с задержкой в несколько кадров.
+  */
+
+
+class FrameProfiler: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса FrameProfiler. */
+    FrameProfiler();
+
+    /*! Деструктор класса FrameProfiler. */
+    ~FrameProfiler();
+
+    /*! Создаёт запросы OpenGL. Не вызывать до создания контекста! */
+    bool init();
+
+    /*! Начинает новый кадр и забирает готовые результаты предыдущих кадров. */
+    void beginFrame();
+
+    /*! Завершает текущий кадр. */
+    void endFrame();
+
+    /*! Начинает замер прохода <i>pass</i>. Проходы не должны быть вложенными. */
+    void beginPass(ProfilerPasses pass);
+
+    /*! Завершает замер текущего прохода. */
+    void endPass();
+
+    /*! Дожидается результатов всех завершённых кадров. Останавливает конвейер, не вызывать каждый кадр! */
+    void finish();
+
+    /*! Возвращает имя прохода <i>pass</i>. */
+    static QString passName(ProfilerPasses pass);
+
+    /*! Возвращает последний кадр, для которого получены результаты GPU. */
+    const FrameTimings &latest() const;
+
+    /*! Возвращает времена, усреднённые по последним <i>frames</i> готовым кадрам. */
+    FrameTimings average(int frames = 60) const;
+
+    /*! Возвращает времена, усреднённые по всем готовым кадрам с момента последнего сброса. */
+    FrameTimings totalAverage() const;
+
+    /*! Сбрасывает накопленные для totalAverage() времена. */
+    void resetTotals();
+
+    /*! Возвращает количество кадров, результаты GPU которых не пришли вовремя и были отброшены. */
+    quint64 droppedFrames() const;
+
+    /*! Возвращает историю готовых кадров в хронологическом порядке. */
+    QVector<FrameTimings> history() const;
+
+    /*! Записывает историю кадров в CSV-файл <i>fileName</i>. */
+    bool exportCsv(const QString &fileName) const;
+
+    /*! Включает сохранение всех готовых кадров, а не только последних HISTORY_SIZE. */
+    void setRecording(bool enabled);
+
+    /*! Возвращает все кадры, готовые с момента включения записи. */
+    const QVector<FrameTimings> &recorded() const;
+
+    /*! Записывает кадры <i>frames</i> в CSV-файл <i>fileName</i>. */
+    static bool writeCsv(const QString &fileName, const QVector<FrameTimings> &frames);
+
+private:
+    void collectResults(bool wait);
+    void pushHistory(const FrameTimings &timings);
+
+    static const int FRAME_LATENCY = 3;
+    static const int HISTORY_SIZE = 1024;
+    static const int PASS_COUNT = (int)ProfilerPasses::Count;
+
+    bool m_initialized;
+    quint64 m_frameCount;
+
+    GLuint m_queries[FRAME_LATENCY][PASS_COUNT];
+    bool m_queryIssued[FRAME_LATENCY][PASS_COUNT];
+    bool m_slotPending[FRAME_LATENCY];
+    FrameTimings m_slotTimings[FRAME_LATENCY];
+    int m_currentSlot;
+
+    int m_activePass;
+    QElapsedTimer m_frameTimer;
+    QElapsedTimer m_passTimer;
+
+    QVector<FrameTimings> m_history;
+    int m_historyStart;
+    FrameTimings m_latest;
+
+    FrameTimings m_totals;
+    quint64 m_totalFrames;
+    quint64 m_droppedFrames;
+
+    bool m_recording;
+    QVector<FrameTimings> m_recorded;
+};
+
+#endif // FRAMEPROFILER_H
@@ -0,0 +1,227 @@
+#include "glstatecache.h"
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+bool GLStateCache::init()
+{
+    return initializeOpenGLFunctions();
+}
+
+void GLStateCache::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    for(int i = 0; i < BUFFER_SLOTS; ++i)
+        m_buffers[i] = UNKNOWN;
+    m_activeTexture = UNKNOWN;
+    for(int i = 0; i < TEXTURE_UNITS; ++i)
+        m_textures[i] = UNKNOWN;
+    m_blendEnabled = -1;
+    m_blendSource = UNKNOWN;
+    m_blendDestination = UNKNOWN;
+    invalidateFramebuffers();
+}
+
+void GLStateCache::invalidateFramebuffers()
+{
+    m_drawFramebuffer = UNKNOWN;
+    m_readFramebuffer = UNKNOWN;
+    m_viewportKnown = false;
+}
+
+void GLStateCache::beginFrame()
+{
+    m_counters.reset();
+}
+
+void GLStateCache::endFrame()
+{
+    m_lastFrame = m_counters;
+}
+
+const GLStateCounters &GLStateCache::lastFrame() const
+{
+    return m_lastFrame;
+}
+
+QString GLStateCache::callName(GLStateCalls call)
+{
+    switch(call) {
+    case GLStateCalls::Program:
+        return QStringLiteral("Program");
+    case GLStateCalls::VertexArray:
+        return QStringLiteral("VertexArray");
+    case GLStateCalls::Buffer:
+        return QStringLiteral("Buffer");
+    case GLStateCalls::ActiveTexture:
+        return QStringLiteral("ActiveTexture");
+    case GLStateCalls::Texture:
+        return QStringLiteral("Texture");
+    case GLStateCalls::Blend:
+        return QStringLiteral("Blend");
+    case GLStateCalls::Framebuffer:
+        return QStringLiteral("Framebuffer");
+    case GLStateCalls::Viewport:
+        return QStringLiteral("Viewport");
+    default:
+        return QString();
+    }
+}
+
+bool GLStateCache::changed(GLStateCalls call, bool changed)
+{
+    if(changed)
+        ++m_counters.issued[(int)call];
+    else
+        ++m_counters.skipped[(int)call];
+
+    return changed;
+}
+
+int GLStateCache::bufferSlot(GLenum target)
+{
+    switch(target) {
+    case GL_ARRAY_BUFFER:
+        return 0;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return 1;
+    case GL_PIXEL_PACK_BUFFER:
+        return 2;
+    case GL_PIXEL_UNPACK_BUFFER:
+        return 3;
+    case GL_TRANSFORM_FEEDBACK_BUFFER:
+        return 4;
+    case GL_UNIFORM_BUFFER:
+        return 5;
+    default:
+        return -1;
+    }
+}
+
+bool GLStateCache::useProgram(GLuint program)
+{
+    if(!changed(GLStateCalls::Program, program != m_program))
+        return false;
+
+    glUseProgram(program);
+    m_program = program;
+
+    return true;
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+    if(!changed(GLStateCalls::VertexArray, vertexArray != m_vertexArray))
+        return;
+
+    glBindVertexArray(vertexArray);
+    m_vertexArray = vertexArray;
+
+    // The element array binding belongs to the VAO
+    m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = bufferSlot(target);
+
+    if(!changed(GLStateCalls::Buffer, slot < 0 || buffer != m_buffers[slot]))
+        return;
+
+    glBindBuffer(target, buffer);
+
+    if(slot >= 0)
+        m_buffers[slot] = buffer;
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    int slot = bufferSlot(target);
+
+    // Indexed bindings are not tracked, only the generic binding they replace
+    changed(GLStateCalls::Buffer, true);
+    glBindBufferBase(target, index, buffer);
+
+    if(slot >= 0)
+        m_buffers[slot] = buffer;
+}
+
+void GLStateCache::activeTexture(GLenum unit)
+{
+    if(!changed(GLStateCalls::ActiveTexture, unit != m_activeTexture))
+        return;
+
+    glActiveTexture(unit);
+    m_activeTexture = unit;
+}
+
+void GLStateCache::bindTexture(GLenum unit, GLuint texture)
+{
+    int index = unit - GL_TEXTURE0;
+    bool tracked = index >= 0 && index < TEXTURE_UNITS;
+
+    if(!changed(GLStateCalls::Texture, !tracked || texture != m_textures[index]))
+        return;
+
+    activeTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    if(tracked)
+        m_textures[index] = texture;
+}
+
+void GLStateCache::setBlendEnabled(bool enabled)
+{
+    if(!changed(GLStateCalls::Blend, (int)enabled != m_blendEnabled))
+        return;
+
+    if(enabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+
+    m_blendEnabled = enabled;
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+    if(!changed(GLStateCalls::Blend, source != m_blendSource || destination != m_blendDestination))
+        return;
+
+    glBlendFunc(source, destination);
+    m_blendSource = source;
+    m_blendDestination = destination;
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool draw = target != GL_READ_FRAMEBUFFER;
+    bool read = target != GL_DRAW_FRAMEBUFFER;
+
+    if(!changed(GLStateCalls::Framebuffer, (draw && framebuffer != m_drawFramebuffer) || (read && framebuffer != m_readFramebuffer)))
+        return;
+
+    glBindFramebuffer(target, framebuffer);
+
+    if(draw)
+        m_drawFramebuffer = framebuffer;
+    if(read)
+        m_readFramebuffer = framebuffer;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if(!changed(GLStateCalls::Viewport, !m_viewportKnown || x != m_viewport[0] || y != m_viewport[1] || width != m_viewport[2] || height != m_viewport[3]))
+        return;
+
+    glViewport(x, y, width, height);
+
+    m_viewport[0] = x;
+    m_viewport[1] = y;
+    m_viewport[2] = width;
+    m_viewport[3] = height;
+    m_viewportKnown = true;
+}
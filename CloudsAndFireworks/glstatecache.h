@@ -0,0 +1,150 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+
+enum class GLStateCalls
+{
+    Program,
+    VertexArray,
+    Buffer,
+    ActiveTexture,
+    Texture,
+    Blend,
+    Framebuffer,
+    Viewport,
+    Count
+};
+
+struct GLStateCounters
+{
+    quint32 issued[(int)GLStateCalls::Count];
+    quint32 skipped[(int)GLStateCalls::Count];
+
+    GLStateCounters()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for(int i = 0; i < (int)GLStateCalls::Count; ++i) {
+            issued[i] = 0;
+            skipped[i] = 0;
+        }
+    }
+
+    quint32 totalIssued() const
+    {
+        quint32 result = 0;
+        for(int i = 0; i < (int)GLStateCalls::Count; ++i)
+            result += issued[i];
+        return result;
+    }
+
+    quint32 totalSkipped() const
+    {
+        quint32 result = 0;
+        for(int i = 0; i < (int)GLStateCalls::Count; ++i)
+            result += skipped[i];
+        return result;
+    }
+};
+
+/*!
+  @brief Класс теневой копии состояния OpenGL.
+
+  Хранит текущую программу, VAO, буфферы, текстуры на каждом блоке, смешивание, фреймбуфферы и область вывода.
+  Вызов, не меняющий состояние, не передаётся в OpenGL. Выполненные и пропущенные вызовы считаются за кадр.
+  Все изменения этого состояния должны идти через этот класс, иначе копия устареет.
+  */
+
+
+class GLStateCache: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса GLStateCache. */
+    GLStateCache();
+
+    /*! Инициализирует функции OpenGL. Не вызывать до создания контекста! */
+    bool init();
+
+    /*! Помечает всё состояние неизвестным, например после рисования через QPainter. */
+    void invalidate();
+
+    /*! Помечает неизвестными только привязки фреймбуфферов и область вывода, например перед paintGL(). */
+    void invalidateFramebuffers();
+
+    /*!
+     * Начинает новый кадр и обнуляет счётчики. Копия состояния переживает кадр, после кода в обход копии
+     * её нужно сбросить через invalidate().
+     */
+    void beginFrame();
+
+    /*! Завершает кадр и сохраняет его счётчики. */
+    void endFrame();
+
+    /*! Возвращает счётчики последнего завершённого кадра. */
+    const GLStateCounters &lastFrame() const;
+
+    /*! Возвращает имя вида вызова <i>call</i>. */
+    static QString callName(GLStateCalls call);
+
+    /*! Делает текущей программу <i>program</i>. Возвращает <i>true</i>, если вызов выполнен. */
+    bool useProgram(GLuint program);
+
+    /*! Биндит VAO <i>vertexArray</i>. */
+    void bindVertexArray(GLuint vertexArray);
+
+    /*! Биндит буффер <i>buffer</i> к <i>target</i>. */
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    /*! Биндит буффер <i>buffer</i> к точке <i>index</i> цели <i>target</i>. Всегда выполняется, меняет и общий биндинг цели. */
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    /*! Делает активным текстурный блок <i>unit</i> (GL_TEXTURE0 + n). */
+    void activeTexture(GLenum unit);
+
+    /*! Биндит двумерную текстуру <i>texture</i> к текстурному блоку <i>unit</i>. */
+    void bindTexture(GLenum unit, GLuint texture);
+
+    /*! Включает или выключает смешивание. */
+    void setBlendEnabled(bool enabled);
+
+    /*! Задаёт функцию смешивания. */
+    void blendFunc(GLenum source, GLenum destination);
+
+    /*! Биндит фреймбуффер <i>framebuffer</i> к <i>target</i> (GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER или GL_READ_FRAMEBUFFER). */
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+    /*! Задаёт область вывода. */
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+private:
+    bool changed(GLStateCalls call, bool changed);
+    static int bufferSlot(GLenum target);
+
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+    static const int BUFFER_SLOTS = 6;
+    static const int TEXTURE_UNITS = 16;
+
+    GLuint m_program;
+    GLuint m_vertexArray;
+    GLuint m_buffers[BUFFER_SLOTS];
+    GLenum m_activeTexture;
+    GLuint m_textures[TEXTURE_UNITS];
+    int m_blendEnabled;
+    GLenum m_blendSource;
+    GLenum m_blendDestination;
+    GLuint m_drawFramebuffer;
+    GLuint m_readFramebuffer;
+    GLint m_viewport[4];
+    bool m_viewportKnown;
+
+    GLStateCounters m_counters;
+    GLStateCounters m_lastFrame;
+};
+
+#endif // GLSTATECACHE_H
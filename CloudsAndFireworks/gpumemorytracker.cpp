@@ -0,0 +1,190 @@
+#include "gpumemorytracker.h"
+#include <QtDebug>
+
+GpuMemoryTracker::GpuMemoryTracker()
+    : m_total(0)
+    , m_peak(0)
+    , m_budget(0)
+    , m_overBudget(false)
+{
+    for(int i = 0; i < CATEGORY_COUNT; ++i) {
+        m_totals[i] = 0;
+        m_peaks[i] = 0;
+    }
+}
+
+void GpuMemoryTracker::registerAllocation(const void *object, GpuMemoryCategories category, const QString &owner, const QString &format, qint64 bytes)
+{
+    unregisterAllocation(object);
+
+    m_allocations.insert(object, GpuAllocation(category, owner, format, bytes));
+
+    m_totals[(int)category] += bytes;
+    m_total += bytes;
+
+    m_peaks[(int)category] = qMax(m_peaks[(int)category], m_totals[(int)category]);
+    m_peak = qMax(m_peak, m_total);
+
+    checkBudget();
+}
+
+void GpuMemoryTracker::unregisterAllocation(const void *object)
+{
+    QHash<const void*, GpuAllocation>::iterator it = m_allocations.find(object);
+
+    if(it == m_allocations.end())
+        return;
+
+    m_totals[(int)it.value().category] -= it.value().bytes;
+    m_total -= it.value().bytes;
+    m_allocations.erase(it);
+
+    checkBudget();
+}
+
+void GpuMemoryTracker::registerTexture(QOpenGLTexture *texture, const QString &owner)
+{
+    registerAllocation(texture, GpuMemoryCategories::Textures, owner, formatName(texture->format()),
+                       textureBytes(texture->width(), texture->height(), texture->mipLevels(), texture->format()));
+}
+
+qint64 GpuMemoryTracker::total(GpuMemoryCategories category) const
+{
+    return m_totals[(int)category];
+}
+
+qint64 GpuMemoryTracker::total() const
+{
+    return m_total;
+}
+
+qint64 GpuMemoryTracker::peak(GpuMemoryCategories category) const
+{
+    return m_peaks[(int)category];
+}
+
+qint64 GpuMemoryTracker::peak() const
+{
+    return m_peak;
+}
+
+void GpuMemoryTracker::setBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    m_overBudget = false;
+
+    checkBudget();
+}
+
+qint64 GpuMemoryTracker::budget() const
+{
+    return m_budget;
+}
+
+QVector<GpuAllocation> GpuMemoryTracker::allocations() const
+{
+    return m_allocations.values().toVector();
+}
+
+void GpuMemoryTracker::dump() const
+{
+    for(QHash<const void*, GpuAllocation>::const_iterator it = m_allocations.constBegin(); it != m_allocations.constEnd(); ++it) {
+        qDebug().noquote() << QStringLiteral("%1 %2 %3 %4 KiB").arg(categoryName(it.value().category), -12)
+                                                              .arg(it.value().owner, -24)
+                                                              .arg(it.value().format, -12)
+                                                              .arg(it.value().bytes / 1024.0, 10, 'f', 1);
+    }
+
+    for(int i = 0; i < CATEGORY_COUNT; ++i) {
+        qDebug().noquote() << QStringLiteral("%1 %2 MiB, peak %3 MiB").arg(categoryName((GpuMemoryCategories)i), -12)
+                                                                     .arg(m_totals[i] / 1048576.0, 0, 'f', 2)
+                                                                     .arg(m_peaks[i] / 1048576.0, 0, 'f', 2);
+    }
+
+    qDebug().noquote() << QStringLiteral("Total %1 MiB, peak %2 MiB").arg(m_total / 1048576.0, 0, 'f', 2).arg(m_peak / 1048576.0, 0, 'f', 2);
+}
+
+void GpuMemoryTracker::checkBudget()
+{
+    // Warns once per crossing, not on every allocation above the budget
+    if(m_budget > 0 && m_total > m_budget && !m_overBudget) {
+        qWarning().noquote() << QStringLiteral("GpuMemoryTracker: %1 MiB allocated, over the budget of %2 MiB!")
+                                .arg(m_total / 1048576.0, 0, 'f', 2).arg(m_budget / 1048576.0, 0, 'f', 2);
+    }
+
+    m_overBudget = m_budget > 0 && m_total > m_budget;
+}
+
+QString GpuMemoryTracker::categoryName(GpuMemoryCategories category)
+{
+    switch(category) {
+    case GpuMemoryCategories::Textures:
+        return QStringLiteral("Textures");
+    case GpuMemoryCategories::Buffers:
+        return QStringLiteral("Buffers");
+    case GpuMemoryCategories::Framebuffers:
+        return QStringLiteral("Framebuffers");
+    default:
+        return QString();
+    }
+}
+
+qint64 GpuMemoryTracker::textureBytes(int width, int height, int mipLevels, QOpenGLTexture::TextureFormat format)
+{
+    qint64 result = 0;
+
+    for(int level = 0; level < qMax(mipLevels, 1); ++level) {
+        qint64 levelWidth = qMax(width >> level, 1);
+        qint64 levelHeight = qMax(height >> level, 1);
+        qint64 blocks = ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4);
+
+        switch(format) {
+        case QOpenGLTexture::RGB_DXT1:
+        case QOpenGLTexture::RGBA_DXT1:
+            result += blocks * 8;
+            break;
+        case QOpenGLTexture::RGBA_DXT3:
+        case QOpenGLTexture::RGBA_DXT5:
+            result += blocks * 16;
+            break;
+        case QOpenGLTexture::R8_UNorm:
+            result += levelWidth * levelHeight;
+            break;
+        case QOpenGLTexture::RGBA16F:
+            result += levelWidth * levelHeight * 8;
+            break;
+        case QOpenGLTexture::RGBA32F:
+            result += levelWidth * levelHeight * 16;
+            break;
+        default:
+            // Everything else the app creates is 8 bits per channel, RGB is padded to 4 bytes by the drivers
+            result += levelWidth * levelHeight * 4;
+            break;
+        }
+    }
+
+    return result;
+}
+
+QString GpuMemoryTracker::formatName(QOpenGLTexture::TextureFormat format)
+{
+    switch(format) {
+    case QOpenGLTexture::RGB_DXT1:
+    case QOpenGLTexture::RGBA_DXT1:
+        return QStringLiteral("DXT1");
+    case QOpenGLTexture::RGBA_DXT3:
+        return QStringLiteral("DXT3");
+    case QOpenGLTexture::RGBA_DXT5:
+        return QStringLiteral("DXT5");
+    case QOpenGLTexture::R8_UNorm:
+        return QStringLiteral("R8");
+    case QOpenGLTexture::RGBA16F:
+        return QStringLiteral("RGBA16F");
+    case QOpenGLTexture::RGBA32F:
+        return QStringLiteral("RGBA32F");
+    case QOpenGLTexture::RGB8_UNorm:
+        return QStringLiteral("RGB8");
+    default:
+        return QStringLiteral("RGBA8");
+    }
+}
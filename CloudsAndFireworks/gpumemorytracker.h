@@ -0,0 +1,106 @@
+#ifndef GPUMEMORYTRACKER_H
+#define GPUMEMORYTRACKER_H
+
+#include <QOpenGLTexture>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+enum class GpuMemoryCategories
+{
+    Textures,
+    Buffers,
+    Framebuffers,
+    Count
+};
+
+struct GpuAllocation
+{
+    GpuMemoryCategories category;
+    QString owner;
+    QString format;
+    qint64 bytes;
+
+    GpuAllocation(GpuMemoryCategories category = GpuMemoryCategories::Textures, const QString &owner = QString(),
+                  const QString &format = QString(), qint64 bytes = 0)
+        : category(category)
+        , owner(owner)
+        , format(format)
+        , bytes(bytes) {}
+};
+
+/*!
+  @brief Класс учёта видеопамяти.
+
+  Каждое выделение памяти на GPU регистрируется с категорией, владельцем, форматом и размером.
+  Размеры оцениваются по формату, реальный расход драйвера может отличаться из-за выравнивания.
+  При превышении бюджета выводится предупреждение.
+  */
+
+
+class GpuMemoryTracker
+{
+
+public:
+    /*! Конструктор класса GpuMemoryTracker. */
+    GpuMemoryTracker();
+
+    /*!
+     * Регистрирует выделение памяти объектом <i>object</i>. Повторная регистрация того же объекта заменяет запись,
+     * например после изменения размера фреймбуффера.
+     */
+    void registerAllocation(const void *object, GpuMemoryCategories category, const QString &owner, const QString &format, qint64 bytes);
+
+    /*! Удаляет запись объекта <i>object</i>. */
+    void unregisterAllocation(const void *object);
+
+    /*! Это перегруженная функция, регистрирует текстуру <i>texture</i> с размером, рассчитанным по её формату. */
+    void registerTexture(QOpenGLTexture *texture, const QString &owner);
+
+    /*! Возвращает текущий объём памяти категории <i>category</i> в байтах. */
+    qint64 total(GpuMemoryCategories category) const;
+
+    /*! Возвращает текущий объём памяти всех категорий в байтах. */
+    qint64 total() const;
+
+    /*! Возвращает наибольший объём памяти категории <i>category</i> за время работы. */
+    qint64 peak(GpuMemoryCategories category) const;
+
+    /*! Возвращает наибольший общий объём памяти за время работы. */
+    qint64 peak() const;
+
+    /*! Задаёт бюджет видеопамяти в байтах, 0 отключает проверку. */
+    void setBudget(qint64 bytes);
+
+    qint64 budget() const;
+
+    /*! Возвращает все зарегистрированные выделения. */
+    QVector<GpuAllocation> allocations() const;
+
+    /*! Выводит все выделения и итоги в отладочный вывод. */
+    void dump() const;
+
+    /*! Возвращает имя категории <i>category</i>. */
+    static QString categoryName(GpuMemoryCategories category);
+
+    /*! Возвращает размер текстуры <i>width</i> x <i>height</i> с <i>mipLevels</i> уровнями в формате <i>format</i>. */
+    static qint64 textureBytes(int width, int height, int mipLevels, QOpenGLTexture::TextureFormat format);
+
+    /*! Возвращает имя формата текстуры <i>format</i>. */
+    static QString formatName(QOpenGLTexture::TextureFormat format);
+
+private:
+    void checkBudget();
+
+    static const int CATEGORY_COUNT = (int)GpuMemoryCategories::Count;
+
+    QHash<const void*, GpuAllocation> m_allocations;
+    qint64 m_totals[CATEGORY_COUNT];
+    qint64 m_peaks[CATEGORY_COUNT];
+    qint64 m_total;
+    qint64 m_peak;
+    qint64 m_budget;
+    bool m_overBudget;
+};
+
+#endif // GPUMEMORYTRACKER_H
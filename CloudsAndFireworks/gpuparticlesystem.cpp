@@ -0,0 +1,352 @@
+#include "gpuparticlesystem.h"
+#include "tracer.h"
+#include <QOpenGLContext>
+#include <QtDebug>
+#include <cstring>
+#include <cmath>
+
+const float GpuParticleSystem::CHECK_TOLERANCE = 0.01f;
+
+GpuParticleSystem::GpuParticleSystem()
+    : m_resourceManager(NULL)
+    , m_program(NULL)
+    , m_trailProgram(NULL)
+    , m_current(0)
+    , m_stepCount(0)
+    , m_count(0)
+    , m_capacity(0)
+    , m_checkEnabled(false)
+    , m_checkedFrames(0)
+    , m_maxError(0.0f)
+{
+    for(int i = 0; i < 2; ++i) {
+        m_buffers[i] = 0;
+        m_vertexArrays[i] = 0;
+        m_trailVertexArrays[i] = 0;
+    }
+}
+
+GpuParticleSystem::~GpuParticleSystem()
+{
+    if(!m_resourceManager)
+        return;
+
+    m_resourceManager->memory().unregisterAllocation(this);
+
+    if(QOpenGLContext::currentContext()) {
+        glDeleteVertexArrays(2, m_vertexArrays);
+        glDeleteVertexArrays(2, m_trailVertexArrays);
+        glDeleteBuffers(2, m_buffers);
+    }
+}
+
+bool GpuParticleSystem::init(ResourceManager &resourceManager, FireworkTypes type, const QString &name)
+{
+    if(!initializeOpenGLFunctions())
+        return false;
+
+    m_resourceManager = &resourceManager;
+    m_name = name;
+
+    // The integration constants come from Firework, so both simulations step with the same numbers
+    QStringList defines;
+    defines << QStringLiteral("GRAVITY %1").arg(Firework::GRAVITY, 0, 'f', 6)
+            << QStringLiteral("DAMPING %1").arg(Firework::DAMPING, 0, 'f', 6)
+            << QStringLiteral("LAUNCH_POSITION_Y %1").arg(Firework::LAUNCH_POSITION_Y, 0, 'f', 6);
+
+    m_program = resourceManager.createShaderProgram("", ":/shaders/particlesim.vert", ":/shaders/particlesim.geom", defines,
+                                                    QStringList() << "tf_position" << "tf_size" << "tf_angle" << "tf_color"
+                                                                  << "tf_velocity" << "tf_life" << "tf_blink"
+                                                                  << "tf_trajectoryOrigin" << "tf_trajectoryVelocity" << "tf_trajectoryColor"
+                                                                  << "tf_trajectoryParams" << "tf_trajectorySeed");
+
+    if(type == FireworkTypes::Snakes)
+        m_trailProgram = resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/trajectory.vert", ":/shaders/pointsprite.geom",
+                                                             QStringList(defines) << "POINT_SPRITES" << "MODE SNAKES");
+
+    glGenVertexArrays(2, m_vertexArrays);
+    glGenVertexArrays(2, m_trailVertexArrays);
+    reserve(INITIAL_CAPACITY);
+
+    return true;
+}
+
+void GpuParticleSystem::emitBurst(const QVector<GpuParticle> &particles)
+{
+    if(particles.isEmpty())
+        return;
+
+    reserve(m_count + particles.size());
+
+    // The trail is drawn relative to the step the burst appeared at
+    QVector<GpuParticle> stamped(particles);
+    for(int i = 0; i < stamped.size(); ++i)
+        stamped[i].trajectory.spawnFrame = (GLfloat)m_stepCount;
+
+    // New particles are appended to the current state and are stepped from the next frame on, like the CPU bursts
+    m_resourceManager->state().bindBuffer(GL_ARRAY_BUFFER, m_buffers[m_current]);
+    glBufferSubData(GL_ARRAY_BUFFER, m_count * sizeof(GpuParticle), stamped.size() * sizeof(GpuParticle), stamped.constData());
+
+    m_bursts << GpuParticleBurst(particles.size(), (int)particles.first().life, (int)particles.first().trajectory.maxTail);
+    m_count += particles.size();
+
+    if(m_checkEnabled) {
+        for(int i = 0; i < particles.size(); ++i) {
+            m_mirror << Particle(particles.at(i).position.x(), particles.at(i).position.y());
+            m_mirror.last().setVelocity(particles.at(i).velocity);
+            m_mirror.last().setColor(particles.at(i).color);
+        }
+    }
+}
+
+void GpuParticleSystem::step(uint frame)
+{
+    ++m_stepCount;
+
+    if(!m_count)
+        return;
+
+    TRACE_SCOPE("GpuParticleSystem::step");
+
+    GLStateCache &state = m_resourceManager->state();
+    int target = 1 - m_current;
+
+    m_resourceManager->bindShaderProgram(m_program);
+    m_program->setUniformValue("frame", (GLuint)frame);
+
+    state.bindVertexArray(m_vertexArrays[m_current]);
+    state.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_buffers[target]);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, m_count);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    state.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    m_current = target;
+
+    // Bursts die as a whole, so the number of particles written back is known without a query
+    int offset = 0;
+    m_count = 0;
+
+    for(int i = 0; i < m_bursts.size(); ++i) {
+        if(--m_bursts[i].life <= 0) {
+            if(m_checkEnabled)
+                m_mirror.remove(offset, m_bursts.at(i).count);
+            m_bursts.removeAt(i--);
+            continue;
+        }
+
+        offset += m_bursts.at(i).count;
+        m_count += m_bursts.at(i).count;
+    }
+
+    if(m_checkEnabled)
+        check();
+}
+
+void GpuParticleSystem::draw()
+{
+    if(!m_count)
+        return;
+
+    m_resourceManager->state().bindVertexArray(m_vertexArrays[m_current]);
+    glDrawArrays(GL_POINTS, 0, m_count);
+}
+
+void GpuParticleSystem::drawTrails(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture)
+{
+    if(!m_count || !m_trailProgram)
+        return;
+
+    int trailLength = 0;
+    for(int i = 0; i < m_bursts.size(); ++i)
+        trailLength = qMax(trailLength, m_bursts.at(i).maxTail);
+
+    if(!trailLength)
+        return;
+
+    m_resourceManager->bindShaderProgram(m_trailProgram);
+    m_trailProgram->setUniformValue("tex", 0);
+    m_trailProgram->setUniformValue("time", (GLfloat)m_stepCount);
+    m_trailProgram->setUniformValue("modelViewProjectionMatrix", modelViewProjection);
+    m_resourceManager->bindTexture(texture);
+
+    // Vertex k of an instance is trail node k, node 0 is the head that draw() takes from the simulated state
+    m_resourceManager->state().bindVertexArray(m_trailVertexArrays[m_current]);
+    glDrawArraysInstanced(GL_POINTS, 1, trailLength, m_count);
+}
+
+int GpuParticleSystem::count() const
+{
+    return m_count;
+}
+
+void GpuParticleSystem::setCheckEnabled(bool enabled)
+{
+    // Particles emitted before the check was enabled have no CPU counterpart
+    if(enabled && !m_checkEnabled && m_count)
+        qWarning() << QStringLiteral("GpuParticleSystem: check enabled with particles in flight, they are not compared!");
+
+    m_checkEnabled = enabled && !m_count;
+    m_mirror.clear();
+}
+
+bool GpuParticleSystem::isCheckEnabled() const
+{
+    return m_checkEnabled;
+}
+
+uint GpuParticleSystem::checkedFrames() const
+{
+    return m_checkedFrames;
+}
+
+float GpuParticleSystem::maxError() const
+{
+    return m_maxError;
+}
+
+float GpuParticleSystem::selfCheck(int steps)
+{
+    if(m_count) {
+        qWarning() << QStringLiteral("GpuParticleSystem: self-check skipped,") << m_name << QStringLiteral("has particles in flight!");
+        return 0.0f;
+    }
+
+    bool checkEnabled = m_checkEnabled;
+    uint checkedFrames = m_checkedFrames;
+    float maxError = m_maxError;
+
+    m_checkEnabled = true;
+    m_maxError = 0.0f;
+
+    // A ring launched close to the ground, so the ground clamp is compared as well. It lives longer than the test.
+    QVector<GpuParticle> particles;
+    float angle;
+
+    for(int i = 0; i < 64; ++i) {
+        angle = i * 2.0f * (float)M_PI / 64.0f;
+        particles << GpuParticle(QVector2D(200.0f, 40.0f), QVector2D(1.0f, 1.0f), 0.0f, GLColor(),
+                                 QVector2D(3.0f * cosf(angle), 3.0f * sinf(angle)), steps + 1, 0.0f);
+    }
+
+    emitBurst(particles);
+
+    for(int i = 0; i < steps; ++i)
+        step(i);
+
+    float error = m_maxError;
+
+    m_count = 0;
+    m_bursts.clear();
+    m_mirror.clear();
+    m_checkEnabled = checkEnabled;
+    m_checkedFrames = checkedFrames;
+    m_maxError = maxError;
+
+    return error;
+}
+
+void GpuParticleSystem::reserve(int count)
+{
+    if(count <= m_capacity)
+        return;
+
+    GLStateCache &state = m_resourceManager->state();
+    int capacity = qMax(count, m_capacity * 2);
+    GLuint buffers[2];
+
+    glGenBuffers(2, buffers);
+
+    for(int i = 0; i < 2; ++i) {
+        state.bindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GpuParticle), NULL, GL_DYNAMIC_COPY);
+    }
+
+    // Only the current state has to survive, the other buffer is overwritten by the next step
+    if(m_count) {
+        state.bindBuffer(GL_COPY_READ_BUFFER, m_buffers[m_current]);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, buffers[m_current]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_count * sizeof(GpuParticle));
+    }
+
+    glDeleteBuffers(2, m_buffers);
+    memcpy(m_buffers, buffers, sizeof(buffers));
+    m_capacity = capacity;
+
+    setupVertexArrays();
+
+    m_resourceManager->memory().registerAllocation(this, GpuMemoryCategories::Buffers, m_name, QStringLiteral("Transform feedback"),
+                                                   qint64(2) * capacity * sizeof(GpuParticle));
+}
+
+void GpuParticleSystem::setupVertexArrays()
+{
+    GLStateCache &state = m_resourceManager->state();
+
+    // Locations 0-3 are shared with pointsprite.vert, the same VAO serves the simulation and the drawing
+    for(int i = 0; i < 2; ++i) {
+        state.bindVertexArray(m_vertexArrays[i]);
+        state.bindBuffer(GL_ARRAY_BUFFER, m_buffers[i]);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, position));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, size));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, angle));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, color));
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, velocity));
+        glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, life));
+        glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)offsetof(GpuParticle, blink));
+
+        setupTrajectoryAttributes(7);
+
+        for(GLuint j = 0; j < 12; ++j)
+            glEnableVertexAttribArray(j);
+
+        // The trail VAO reads the same buffer as trajectory.vert reads the analytic one, one instance per particle
+        state.bindVertexArray(m_trailVertexArrays[i]);
+        setupTrajectoryAttributes(0);
+
+        for(GLuint j = 0; j < 5; ++j) {
+            glEnableVertexAttribArray(j);
+            glVertexAttribDivisor(j, 1);
+        }
+    }
+}
+
+void GpuParticleSystem::setupTrajectoryAttributes(GLuint location)
+{
+    const size_t base = offsetof(GpuParticle, trajectory);
+
+    // Same attributes as trajectory.vert, starting at location
+    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)(base + offsetof(TrajectoryData, origin)));
+    glVertexAttribPointer(location + 1, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)(base + offsetof(TrajectoryData, velocity)));
+    glVertexAttribPointer(location + 2, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)(base + offsetof(TrajectoryData, color)));
+    glVertexAttribPointer(location + 3, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)(base + offsetof(TrajectoryData, spawnFrame)));
+    glVertexAttribPointer(location + 4, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (const void *)(base + offsetof(TrajectoryData, seed)));
+}
+
+void GpuParticleSystem::check()
+{
+    for(int i = 0; i < m_mirror.size(); ++i)
+        Firework::moveParticle(m_mirror[i]);
+
+    QVector<GpuParticle> particles(m_count);
+
+    m_resourceManager->state().bindBuffer(GL_ARRAY_BUFFER, m_buffers[m_current]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(GpuParticle), particles.data());
+
+    float error = 0.0f;
+
+    for(int i = 0; i < m_count; ++i) {
+        error = qMax(error, (particles.at(i).position - m_mirror.at(i).getPosition()).length());
+        error = qMax(error, (particles.at(i).velocity - m_mirror.at(i).getVelocity()).length());
+    }
+
+    if(error > CHECK_TOLERANCE && m_maxError <= CHECK_TOLERANCE)
+        qWarning() << QStringLiteral("GpuParticleSystem:") << m_name << QStringLiteral("differs from the CPU simulation by") << error;
+
+    m_maxError = qMax(m_maxError, error);
+    ++m_checkedFrames;
+}
@@ -0,0 +1,151 @@
+#ifndef GPUPARTICLESYSTEM_H
+#define GPUPARTICLESYSTEM_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector>
+#include <QString>
+#include "resourcemanager.h"
+#include "firework.h"
+#include "analyticparticlesystem.h"
+
+enum class SimulationModes
+{
+    Cpu,
+    Gpu,
+    Analytic
+};
+
+/*!
+ * Частица в буффере GPU. Начало совпадает с PointSpriteData, поэтому буффер рисуется шейдером pointsprite.vert.
+ * <i>trajectory</i> хранит параметры взрыва, по ним trajectory.vert строит след змейки.
+ */
+struct GpuParticle
+{
+    QVector2D position;
+    QVector2D size;
+    GLfloat angle;
+    GLColor color;
+    QVector2D velocity;
+    GLfloat life;
+    GLfloat blink;
+    TrajectoryData trajectory;
+
+    GpuParticle(QVector2D position = QVector2D(0.0f, 0.0f),
+                QVector2D size = QVector2D(1.0f, 1.0f),
+                GLfloat angle = 0.0f,
+                GLColor color = GLColor(1.0f, 1.0f, 1.0f, 1.0f),
+                QVector2D velocity = QVector2D(0.0f, 0.0f),
+                GLfloat life = 0.0f,
+                GLfloat blink = 0.0f,
+                TrajectoryData trajectory = TrajectoryData())
+        : position(position)
+        , size(size)
+        , angle(angle)
+        , color(color)
+        , velocity(velocity)
+        , life(life)
+        , blink(blink)
+        , trajectory(trajectory) {}
+};
+
+struct GpuParticleBurst
+{
+    int count;
+    int life;
+    int maxTail;
+
+    GpuParticleBurst(int count = 0, int life = 0, int maxTail = 0)
+        : count(count)
+        , life(life)
+        , maxTail(maxTail) {}
+};
+
+/*!
+  @brief Класс симуляции частиц на GPU.
+
+  Состояние частиц хранится в двух буфферах и продвигается на кадр через transform feedback:
+  вершинный шейдер повторяет шаг Firework::moveParticle(), геометрический отбрасывает частицы в конце полёта.
+  CPU только добавляет новые залпы и считает, сколько частиц осталось. Следы змеек не хранятся: узлы следа
+  вычисляются по параметрам взрыва в замкнутой форме, как в AnalyticParticleSystem. В режиме проверки
+  тот же шаг выполняется на CPU и сравнивается с прочитанным буффером.
+  */
+
+
+class GpuParticleSystem: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса GpuParticleSystem. */
+    GpuParticleSystem();
+
+    /*! Деструктор класса GpuParticleSystem. */
+    ~GpuParticleSystem();
+
+    /*! Создаёт буфферы и программы для фейерверков типа <i>type</i>. Не вызывать до ResourceManager::init()! */
+    bool init(ResourceManager &resourceManager, FireworkTypes type, const QString &name);
+
+    /*!
+     * Добавляет залп <i>particles</i>. У всех частиц залпа должны быть одинаковые время жизни и длина следа.
+     * Кадр появления в <i>trajectory</i> проставляется здесь.
+     */
+    void emitBurst(const QVector<GpuParticle> &particles);
+
+    /*! Продвигает все частицы на один кадр. <i>frame</i> задаёт случайное мерцание. Меняет текущий VAO. */
+    void step(uint frame);
+
+    /*! Рисует частицы точками. Программа и текстура должны быть уже установлены. Меняет текущий VAO. */
+    void draw();
+
+    /*! Рисует следы без голов. Меняет текущий VAO и программу. */
+    void drawTrails(const QMatrix4x4 &modelViewProjection, QOpenGLTexture *texture);
+
+    /*! Возвращает количество живых частиц. */
+    int count() const;
+
+    /*! Включает сравнение с симуляцией на CPU после каждого шага. Читает буффер с GPU, только для проверки! */
+    void setCheckEnabled(bool enabled);
+    bool isCheckEnabled() const;
+
+    /*! Возвращает количество проверенных кадров. */
+    uint checkedFrames() const;
+
+    /*! Возвращает наибольшее расхождение позиции или скорости с CPU за все проверенные кадры. */
+    float maxError() const;
+
+    /*!
+     * Проверяет шаг симуляции на пробном залпе: продвигает его <i>steps</i> кадров на GPU и на CPU и сравнивает.
+     * Возвращает наибольшее расхождение. Вызывать только без частиц в полёте, например сразу после init().
+     */
+    float selfCheck(int steps = 120);
+
+    static const float CHECK_TOLERANCE;
+
+private:
+    void reserve(int count);
+    void setupVertexArrays();
+    void setupTrajectoryAttributes(GLuint location);
+    void check();
+
+    static const int INITIAL_CAPACITY = 4096;
+
+    ResourceManager *m_resourceManager;
+    QString m_name;
+    QOpenGLShaderProgram *m_program;
+    QOpenGLShaderProgram *m_trailProgram;
+
+    GLuint m_buffers[2];
+    GLuint m_vertexArrays[2];
+    GLuint m_trailVertexArrays[2];
+    int m_current;
+    int m_stepCount;
+    int m_count;
+    int m_capacity;
+    QVector<GpuParticleBurst> m_bursts;
+
+    bool m_checkEnabled;
+    QVector<Particle> m_mirror;
+    uint m_checkedFrames;
+    float m_maxError;
+};
+
+#endif // GPUPARTICLESYSTEM_H
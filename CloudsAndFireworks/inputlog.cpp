@@ -0,0 +1,148 @@
+#include "inputlog.h"
+#include <QFile>
+#include <QtDebug>
+#include <cstring>
+
+InputLog::InputLog()
+    : m_recording(false)
+{
+    memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = INPUT_LOG_MAGIC;
+    m_header.version = INPUT_LOG_VERSION;
+}
+
+void InputLog::startRecording(uint seed, uint width, uint height, SimulationModes simulation, uint particleBudget)
+{
+    m_header.seed = seed;
+    m_header.width = width;
+    m_header.height = height;
+    m_header.frames = 0;
+    m_header.simulation = (quint32)simulation;
+    m_header.particleBudget = particleBudget;
+
+    m_events.clear();
+    m_recording = true;
+}
+
+bool InputLog::isRecording() const
+{
+    return m_recording;
+}
+
+void InputLog::recordLaunch(uint frame, const QPointF &position)
+{
+    if(!m_recording)
+        return;
+
+    m_events << LaunchEvent(frame, position.x(), position.y());
+}
+
+bool InputLog::save(const QString &fileName, uint frames)
+{
+    m_recording = false;
+    m_header.frames = frames;
+    m_header.eventCount = m_events.size();
+
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << QStringLiteral("InputLog: failed to open '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    qint64 eventsSize = qint64(m_events.size()) * sizeof(LaunchEvent);
+
+    if(file.write((const char *)&m_header, sizeof(m_header)) != (qint64)sizeof(m_header)
+            || file.write((const char *)m_events.constData(), eventsSize) != eventsSize) {
+        qWarning() << QStringLiteral("InputLog: failed to write '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    qDebug() << QStringLiteral("InputLog: saved") << m_events.size() << QStringLiteral("launches in") << frames
+             << QStringLiteral("frames to '") + fileName + QStringLiteral("'.");
+
+    return true;
+}
+
+bool InputLog::load(const QString &fileName)
+{
+    m_recording = false;
+    m_events.clear();
+
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << QStringLiteral("InputLog: failed to open '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    InputLogHeader header;
+
+    if(file.read((char *)&header, sizeof(header)) != (qint64)sizeof(header)
+            || header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION
+            || header.simulation > (quint32)SimulationModes::Analytic || !header.width || !header.height
+            || file.size() != (qint64)(sizeof(header) + quint64(header.eventCount) * sizeof(LaunchEvent))) {
+        qWarning() << QStringLiteral("InputLog: '") + fileName + QStringLiteral("' is not a valid input log!");
+        return false;
+    }
+
+    m_events.resize(header.eventCount);
+
+    qint64 eventsSize = qint64(header.eventCount) * sizeof(LaunchEvent);
+
+    if(file.read((char *)m_events.data(), eventsSize) != eventsSize) {
+        qWarning() << QStringLiteral("InputLog: failed to read '") + fileName + QStringLiteral("'!");
+        m_events.clear();
+        return false;
+    }
+
+    for(int i = 1; i < m_events.size(); ++i) {
+        if(m_events.at(i).frame < m_events.at(i - 1).frame) {
+            qWarning() << QStringLiteral("InputLog: launches in '") + fileName + QStringLiteral("' are out of order!");
+            m_events.clear();
+            return false;
+        }
+    }
+
+    m_header = header;
+
+    qDebug() << QStringLiteral("InputLog: loaded") << m_events.size() << QStringLiteral("launches in") << header.frames
+             << QStringLiteral("frames from '") + fileName + QStringLiteral("'.");
+
+    return true;
+}
+
+uint InputLog::seed() const
+{
+    return m_header.seed;
+}
+
+uint InputLog::width() const
+{
+    return m_header.width;
+}
+
+uint InputLog::height() const
+{
+    return m_header.height;
+}
+
+uint InputLog::frames() const
+{
+    return m_header.frames;
+}
+
+SimulationModes InputLog::simulation() const
+{
+    return (SimulationModes)m_header.simulation;
+}
+
+uint InputLog::particleBudget() const
+{
+    return m_header.particleBudget;
+}
+
+const QVector<LaunchEvent> &InputLog::events() const
+{
+    return m_events;
+}
@@ -0,0 +1,84 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <QVector>
+#include <QString>
+#include <QPointF>
+#include "gpuparticlesystem.h"
+
+// "CFIL" in a little-endian file
+const quint32 INPUT_LOG_MAGIC = 0x4C494643;
+const quint32 INPUT_LOG_VERSION = 1;
+
+struct InputLogHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 seed;
+    quint32 width;
+    quint32 height;
+    quint32 frames;
+    quint32 simulation;
+    quint32 particleBudget;
+    quint32 eventCount;
+    quint32 reserved;
+};
+
+/*! Запуск фейерверка перед отрисовкой кадра <i>frame</i> в точку, заданную в координатах окна. */
+struct LaunchEvent
+{
+    quint32 frame;
+    float x;
+    float y;
+
+    LaunchEvent(quint32 frame = 0, float x = 0.0f, float y = 0.0f)
+        : frame(frame)
+        , x(x)
+        , y(y) {}
+};
+
+/*!
+  @brief Класс журнала ввода.
+
+  Хранит всё, от чего зависит ход шоу: зерно qrand(), размер кадра, настройки симуляции и запуски с номерами кадров.
+  Записывается окном и проигрывается бенчмарком кадр за кадром, так что две сборки рисуют одно и то же шоу.
+  */
+
+
+class InputLog
+{
+
+public:
+    /*! Конструктор класса InputLog. */
+    InputLog();
+
+    /*! Начинает запись шоу с зерном <i>seed</i> в кадре <i>width</i> x <i>height</i>. */
+    void startRecording(uint seed, uint width, uint height, SimulationModes simulation, uint particleBudget);
+    bool isRecording() const;
+
+    /*! Записывает запуск в точку <i>position</i> перед отрисовкой кадра <i>frame</i>. */
+    void recordLaunch(uint frame, const QPointF &position);
+
+    /*! Завершает запись шоу длиной <i>frames</i> кадров и сохраняет его в файл <i>fileName</i>. */
+    bool save(const QString &fileName, uint frames);
+
+    /*! Загружает и проверяет журнал <i>fileName</i>. Возвращает <i>true</i> при успешной загрузке. */
+    bool load(const QString &fileName);
+
+    uint seed() const;
+    uint width() const;
+    uint height() const;
+    uint frames() const;
+    SimulationModes simulation() const;
+    uint particleBudget() const;
+
+    /*! Возвращает запуски в порядке номеров кадров. */
+    const QVector<LaunchEvent> &events() const;
+
+private:
+    bool m_recording;
+    InputLogHeader m_header;
+    QVector<LaunchEvent> m_events;
+};
+
+#endif // INPUTLOG_H
@@ -0,0 +1,243 @@
+#include "launchserver.h"
+#include "renderer.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QtDebug>
+
+static const qint64 MAX_MESSAGE_SIZE = 2 * sizeof(quint32) + LaunchListener::MAX_BATCH * sizeof(LaunchCommand);
+
+LaunchCommandQueue::LaunchCommandQueue()
+    : m_head(0)
+    , m_tail(0)
+{
+}
+
+quint32 LaunchCommandQueue::freeSpace() const
+{
+    return CAPACITY - (m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire));
+}
+
+bool LaunchCommandQueue::push(const LaunchCommand *commands, quint32 count)
+{
+    quint32 tail = m_tail.load(std::memory_order_relaxed);
+
+    if(CAPACITY - (tail - m_head.load(std::memory_order_acquire)) < count)
+        return false;
+
+    for(quint32 i = 0; i < count; ++i)
+        m_commands[(tail + i) % CAPACITY] = commands[i];
+
+    // The whole batch becomes visible to the reader at once
+    m_tail.store(tail + count, std::memory_order_release);
+
+    return true;
+}
+
+bool LaunchCommandQueue::pop(LaunchCommand &command)
+{
+    quint32 head = m_head.load(std::memory_order_relaxed);
+
+    if(head == m_tail.load(std::memory_order_acquire))
+        return false;
+
+    command = m_commands[head % CAPACITY];
+    m_head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+LaunchListener::LaunchListener(LaunchCommandQueue &queue, LaunchStats &stats)
+    : m_queue(queue)
+    , m_stats(stats)
+    , m_server(NULL)
+    , m_retryTimer(NULL)
+{
+}
+
+void LaunchListener::startListening(const QString &name)
+{
+    // Created here, so that they belong to the listener thread
+    m_server = new QLocalServer(this);
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(1);
+
+    connect(m_server, &QLocalServer::newConnection, this, &LaunchListener::acceptConnections);
+    connect(m_retryTimer, &QTimer::timeout, this, &LaunchListener::readClients);
+
+    m_message.reserve(MAX_MESSAGE_SIZE);
+
+    // A socket file left behind by a crashed instance would block the name
+    QLocalServer::removeServer(name);
+
+    if(!m_server->listen(name)) {
+        qWarning() << QStringLiteral("LaunchServer: failed to listen on '") + name + QStringLiteral("':") << m_server->errorString();
+        return;
+    }
+
+    qDebug() << QStringLiteral("LaunchServer: listening on '") + m_server->fullServerName() + QStringLiteral("'.");
+}
+
+void LaunchListener::stopListening()
+{
+    for(int i = 0; i < m_clients.size(); ++i) {
+        disconnect(m_clients.at(i), 0, this, 0);
+        m_clients.at(i)->abort();
+    }
+
+    qDeleteAll(m_clients);
+    m_clients.clear();
+
+    delete m_server;
+    m_server = NULL;
+    delete m_retryTimer;
+    m_retryTimer = NULL;
+}
+
+void LaunchListener::acceptConnections()
+{
+    while(m_server->hasPendingConnections()) {
+        QLocalSocket *socket = m_server->nextPendingConnection();
+
+        // Unread messages stay in the system buffer and block the writer when the queue is full
+        socket->setParent(NULL);
+        socket->setReadBufferSize(2 * MAX_MESSAGE_SIZE);
+        m_clients << socket;
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            if(!readClient(socket) && !m_retryTimer->isActive())
+                m_retryTimer->start();
+        });
+
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_clients.removeOne(socket);
+            socket->deleteLater();
+        });
+
+        readClient(socket);
+    }
+}
+
+void LaunchListener::readClients()
+{
+    bool stalled = false;
+
+    // A client dropped for an invalid message leaves the list meanwhile
+    QList<QLocalSocket*> clients = m_clients;
+
+    for(int i = 0; i < clients.size(); ++i)
+        stalled |= !readClient(clients.at(i));
+
+    if(stalled)
+        m_retryTimer->start();
+}
+
+bool LaunchListener::readClient(QLocalSocket *socket)
+{
+    quint32 header[2];
+
+    while(socket->bytesAvailable() >= (qint64)sizeof(header)) {
+        socket->peek((char *)header, sizeof(header));
+
+        quint32 size = header[0], count = header[1];
+
+        if(count > MAX_BATCH || size != sizeof(quint32) + count * sizeof(LaunchCommand)) {
+            qWarning() << QStringLiteral("LaunchServer: invalid message, the client is disconnected.");
+            m_stats.rejected.fetch_add(1, std::memory_order_relaxed);
+            socket->abort();
+            return true;
+        }
+
+        if(socket->bytesAvailable() < qint64(sizeof(quint32) + size))
+            return true;
+
+        if(m_queue.freeSpace() < count) {
+            m_stats.stalls.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_message.resize(sizeof(quint32) + size);
+        socket->read(m_message.data(), m_message.size());
+
+        const LaunchCommand *commands = (const LaunchCommand *)(m_message.constData() + sizeof(header));
+
+        for(quint32 i = 0; i < count; ++i) {
+            // The number of rings sets the size of the burst, a few commands with huge ones would exhaust any frame
+            if(commands[i].level && (commands[i].type >= (quint8)FireworkTypes::Count || commands[i].level > FireworkParams::MAX_LEVEL)) {
+                qWarning() << QStringLiteral("LaunchServer: invalid firework type or level, the client is disconnected.");
+                m_stats.rejected.fetch_add(1, std::memory_order_relaxed);
+                socket->abort();
+                return true;
+            }
+        }
+
+        m_queue.push(commands, count);
+
+        m_stats.messages.fetch_add(1, std::memory_order_relaxed);
+        m_stats.commands.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+LaunchServer::LaunchServer()
+    : m_listener(NULL)
+{
+    m_thread.setObjectName(QStringLiteral("LaunchServer"));
+}
+
+LaunchServer::~LaunchServer()
+{
+    stop();
+}
+
+void LaunchServer::start(const QString &name)
+{
+    if(m_listener)
+        return;
+
+    m_listener = new LaunchListener(m_queue, m_stats);
+    m_listener->moveToThread(&m_thread);
+    m_thread.start();
+
+    QMetaObject::invokeMethod(m_listener, "startListening", Qt::QueuedConnection, Q_ARG(QString, name));
+}
+
+void LaunchServer::stop()
+{
+    if(!m_listener)
+        return;
+
+    QMetaObject::invokeMethod(m_listener, "stopListening", Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+
+    delete m_listener;
+    m_listener = NULL;
+}
+
+bool LaunchServer::isRunning() const
+{
+    return m_listener != NULL;
+}
+
+void LaunchServer::drain(Renderer &renderer)
+{
+    LaunchCommand command;
+
+    // Commands beyond the per-frame limit wait in the queue, a full queue stops the listener reading
+    for(int i = 0; i < MAX_LAUNCHES_PER_FRAME && m_queue.pop(command); ++i) {
+        QPointF position(command.x * renderer.width(), command.y * renderer.height());
+
+        if(command.level)
+            renderer.launchFirework(position, FireworkParams((FireworkTypes)command.type, command.level, command.color, command.seed));
+        else
+            renderer.launchFirework(position);
+    }
+}
+
+const LaunchStats &LaunchServer::stats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,160 @@
+#ifndef LAUNCHSERVER_H
+#define LAUNCHSERVER_H
+
+#include <QObject>
+#include <QThread>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <atomic>
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+class Renderer;
+
+/*!
+  Команда запуска в точку, заданную долями ширины и высоты окна, <i>y</i> отсчитывается сверху.
+  Нулевое число колец запускает случайный фейерверк, как щелчок мыши, остальные поля тогда не используются.
+  Больше FireworkParams::MAX_LEVEL колец не бывает, клиент с такой командой отключается.
+  */
+struct LaunchCommand
+{
+    float x;
+    float y;
+    quint32 seed;
+    quint8 type;
+    quint8 level;
+    quint8 color;
+    quint8 reserved;
+};
+
+struct LaunchStats
+{
+    std::atomic<quint64> messages;
+    std::atomic<quint64> commands;
+    std::atomic<quint64> rejected;
+    std::atomic<quint64> stalls;
+
+    LaunchStats()
+        : messages(0)
+        , commands(0)
+        , rejected(0)
+        , stalls(0) {}
+};
+
+/*!
+  @brief Очередь команд запуска без блокировок.
+
+  Один поток пишет, другой читает. Пачка команд добавляется целиком или не добавляется совсем.
+  */
+
+
+class LaunchCommandQueue
+{
+
+public:
+    LaunchCommandQueue();
+
+    /*! Возвращает количество свободных мест. Вызывать только из потока-писателя. */
+    quint32 freeSpace() const;
+
+    /*! Добавляет <i>count</i> команд. Возвращает <i>false</i>, если они не помещаются. Вызывать только из потока-писателя. */
+    bool push(const LaunchCommand *commands, quint32 count);
+
+    /*! Забирает команду в <i>command</i>. Возвращает <i>false</i>, если очередь пуста. Вызывать только из потока-читателя. */
+    bool pop(LaunchCommand &command);
+
+    static const quint32 CAPACITY = 16384;
+
+private:
+    LaunchCommand m_commands[CAPACITY];
+    std::atomic<quint32> m_head;
+    std::atomic<quint32> m_tail;
+};
+
+/*!
+  @brief Класс приёмника команд запуска.
+
+  Живёт в собственном потоке, принимает подключения к локальному сокету и разбирает сообщения:
+  длина в байтах (quint32), количество команд (quint32) и сами команды, всё в порядке байтов машины.
+  Когда очередь заполнена, сообщения остаются в сокете, и клиент упирается в его буффер.
+  */
+
+
+class LaunchListener: public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! Конструктор класса LaunchListener. */
+    LaunchListener(LaunchCommandQueue &queue, LaunchStats &stats);
+
+    static const quint32 MAX_BATCH = 4096;
+
+public slots:
+    /*! Начинает принимать подключения к сокету <i>name</i>. */
+    void startListening(const QString &name);
+
+    /*! Закрывает все подключения и сокет. */
+    void stopListening();
+
+private slots:
+    void acceptConnections();
+    void readClients();
+
+private:
+    bool readClient(QLocalSocket *socket);
+
+    LaunchCommandQueue &m_queue;
+    LaunchStats &m_stats;
+
+    QLocalServer *m_server;
+    QList<QLocalSocket*> m_clients;
+    QTimer *m_retryTimer;
+    QByteArray m_message;
+};
+
+/*!
+  @brief Класс сервера запусков.
+
+  Принимает пачки команд запуска от внешнего пульта через локальный сокет (Unix domain socket или именованный канал)
+  в отдельном потоке и без блокировок передаёт их в поток отрисовки, который забирает их раз в кадр.
+  */
+
+
+class LaunchServer
+{
+
+public:
+    /*! Конструктор класса LaunchServer. */
+    LaunchServer();
+
+    /*! Деструктор класса LaunchServer. */
+    ~LaunchServer();
+
+    /*! Запускает поток приёма команд на сокете <i>name</i>. */
+    void start(const QString &name);
+
+    /*! Останавливает поток приёма команд. */
+    void stop();
+
+    bool isRunning() const;
+
+    /*! Запускает фейерверки по принятым командам, не больше MAX_LAUNCHES_PER_FRAME. Вызывать раз в кадр до render(). */
+    void drain(Renderer &renderer);
+
+    /*! Возвращает счётчики сообщений, команд, отклонённых сообщений и остановок приёма из-за полной очереди. */
+    const LaunchStats &stats() const;
+
+    static const int MAX_LAUNCHES_PER_FRAME = 512;
+
+private:
+    LaunchCommandQueue m_queue;
+    LaunchStats m_stats;
+
+    QThread m_thread;
+    LaunchListener *m_listener;
+};
+
+#endif // LAUNCHSERVER_H
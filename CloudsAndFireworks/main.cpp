@@ -1,9 +1,80 @@
 #include "window.h"
+#include "benchmark.h"
+#include "tracer.h"
+#include "audioengine.h"
+#include "inputlog.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QDateTime>
+#include <QtDebug>
 
 const uint SCREEN_WIDTH = 1280;
 const uint SCREEN_HEIGHT = 800;
 
+// The benchmark runs without widgets, so it must not create a QApplication on a machine without a display
+static bool isHeadless(int argc, char *argv[])
+{
+    for(int i = 1; i < argc; ++i) {
+        if(QByteArray(argv[i]).startsWith("--benchmark") || QByteArray(argv[i]).startsWith("--replay"))
+            return true;
+    }
+    return false;
+}
+
+static bool parseScaleBounds(const QString &value, float &minScale, float &maxScale)
+{
+    QStringList parts = value.split('-');
+    bool minOk = false, maxOk = false;
+
+    if(parts.size() == 1) {
+        minScale = maxScale = parts.at(0).toFloat(&minOk);
+        maxOk = minOk;
+    } else if(parts.size() == 2) {
+        minScale = parts.at(0).toFloat(&minOk);
+        maxScale = parts.at(1).toFloat(&maxOk);
+    }
+
+    return minOk && maxOk && minScale > 0.0f && minScale <= maxScale && maxScale <= 1.0f;
+}
+
+static bool parseSimulationMode(const QString &value, SimulationModes &mode)
+{
+    for(int i = 0; i <= (int)SimulationModes::Analytic; ++i) {
+        if(value == Renderer::simulationModeName((SimulationModes)i)) {
+            mode = (SimulationModes)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parsePattern(const QString &value, LaunchPatterns &pattern)
+{
+    for(int i = 0; i < (int)LaunchPatterns::Count; ++i) {
+        if(value == StressTest::patternName((LaunchPatterns)i)) {
+            pattern = (LaunchPatterns)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parseSize(const QString &value, uint &width, uint &height)
+{
+    QStringList parts = value.split('x');
+    bool widthOk = false, heightOk = false;
+
+    if(parts.size() == 2) {
+        width = parts.at(0).toUInt(&widthOk);
+        height = parts.at(1).toUInt(&heightOk);
+    }
+
+    return widthOk && heightOk && width && height;
+}
+
 int main(int argc, char *argv[])
 {
     QSurfaceFormat format;
@@ -12,8 +83,215 @@ int main(int argc, char *argv[])
     format.setMinorVersion(3);
     QSurfaceFormat::setDefaultFormat(format);
 
-    QApplication app(argc, argv);
-    Window window(SCREEN_WIDTH, SCREEN_HEIGHT);
-    window.show();
-    return app.exec();
+    QScopedPointer<QCoreApplication> app(isHeadless(argc, argv) ? new QGuiApplication(argc, argv)
+                                                                : new QApplication(argc, argv));
+    QCoreApplication::setApplicationName("CloudsAndFireworks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Procedural clouds and fireworks.");
+    parser.addHelpOption();
+
+    QCommandLineOption benchmarkOption("benchmark", "Renders <frames> frames offscreen as fast as possible and prints the timings.", "frames");
+    QCommandLineOption warmupOption("warmup", "Frames rendered before the benchmark measurements start.", "frames", "30");
+    QCommandLineOption sizeOption("size", "Benchmark render size.", "WxH", "1280x800");
+    QCommandLineOption seedOption("seed", "Random seed of the benchmark workload.", "seed", "1");
+    QCommandLineOption launchIntervalOption("launch-interval", "Frames between benchmark launch waves, 0 disables launches.", "frames", "10");
+    QCommandLineOption dumpFrameOption("dump-frame", "Saves the last benchmark frame as PNG to <file>.", "file");
+    QCommandLineOption renderScaleOption("render-scale", "Bounds of the dynamic render scale of the scene layers, e.g. 0.5-1 or 1 to disable it. "
+                                                         "The window defaults to 0.5-1, the benchmark to 1.", "min-max");
+    QCommandLineOption targetFpsOption("target-fps", "Frame rate the dynamic render scale tries to hold.", "fps", "60");
+    QCommandLineOption vramBudgetOption("vram-budget", "Warns when the estimated video memory use exceeds <MiB>.", "MiB", "0");
+    QCommandLineOption simulationOption("simulation", "Simulates the firework particles on the \"cpu\", on the \"gpu\" with transform feedback "
+                                                      "or draws them from closed-form \"analytic\" trajectories.", "mode", "cpu");
+    QCommandLineOption checkSimulationOption("check-simulation", "Compares the GPU simulation with the CPU every frame, the benchmark fails on a mismatch.");
+    QCommandLineOption audioOption("audio", "Sound output: \"device\", \"null\" or a WAV file to record to. "
+                                            "The window defaults to the device, the benchmark to null.", "sink");
+    QCommandLineOption particleBudgetOption("particle-budget", "Live firework particles, trail nodes included, above which new bursts get "
+                                                               "shorter trails and fewer rings. 0 disables it. The window defaults to 20000, "
+                                                               "the benchmark to 0.", "particles");
+    QCommandLineOption recordOption("record", "Records the seed and the launches of the window session to the input log <file>.", "file");
+    QCommandLineOption replayOption("replay", "Renders the show recorded in the input log <file> offscreen, frame by frame, like the benchmark.", "file");
+    QCommandLineOption timingsOption("timings", "Saves the CPU and GPU times of every benchmark or replay frame to the CSV <file>.", "file");
+    QCommandLineOption stressOption("stress", "Runs a stress test that launches <rate> fireworks per second and raises the rate step by step "
+                                              "until the frame time exceeds the limit, in the window or with --benchmark.", "rate");
+    QCommandLineOption stressRampOption("stress-ramp", "Launches per second added after every stress test step, 0 keeps the rate.", "rate", "1");
+    QCommandLineOption stressStepOption("stress-step", "Duration of a stress test step.", "seconds", "4");
+    QCommandLineOption stressLimitOption("stress-limit", "Frame time the stress test must hold, defaults to the --target-fps frame time.", "ms");
+    QCommandLineOption stressPatternOption("stress-pattern", "Launch positions of the stress test: \"random\", \"sweep\", \"circle\" or \"grid\".",
+                                           "pattern", "random");
+    QCommandLineOption showOption("show", "Launches the fireworks from the show file <file> instead of the mouse or the benchmark script.", "file");
+    QCommandLineOption listenOption("listen", "Accepts batches of launch commands from a controller on the local socket <name>.", "name");
+    QCommandLineOption captureOption("capture", "Records every frame to <file> (\"-\" for stdout) as raw RGBA, or as Y4M if the name ends with .y4m.", "file");
+
+    parser.addOption(benchmarkOption);
+    parser.addOption(warmupOption);
+    parser.addOption(sizeOption);
+    parser.addOption(seedOption);
+    parser.addOption(launchIntervalOption);
+    parser.addOption(dumpFrameOption);
+    parser.addOption(captureOption);
+    parser.addOption(vramBudgetOption);
+    parser.addOption(renderScaleOption);
+    parser.addOption(targetFpsOption);
+    parser.addOption(simulationOption);
+    parser.addOption(checkSimulationOption);
+    parser.addOption(audioOption);
+    parser.addOption(particleBudgetOption);
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(timingsOption);
+    parser.addOption(stressOption);
+    parser.addOption(stressRampOption);
+    parser.addOption(stressStepOption);
+    parser.addOption(stressLimitOption);
+    parser.addOption(stressPatternOption);
+    parser.addOption(showOption);
+    parser.addOption(listenOption);
+    parser.process(*app);
+
+    int result = 0;
+    float minRenderScale = 0.5f, maxRenderScale = 1.0f;
+
+    if(parser.isSet(renderScaleOption) && !parseScaleBounds(parser.value(renderScaleOption), minRenderScale, maxRenderScale)) {
+        qCritical("Invalid render scale!");
+        return 1;
+    }
+
+    SimulationModes simulation = SimulationModes::Cpu;
+
+    if(!parseSimulationMode(parser.value(simulationOption), simulation)) {
+        qCritical("Invalid simulation mode!");
+        return 1;
+    }
+
+    StressTestOptions stressOptions;
+    stressOptions.launchRate = parser.value(stressOption).toFloat();
+    stressOptions.rampStep = parser.value(stressRampOption).toFloat();
+    stressOptions.stepSeconds = parser.value(stressStepOption).toFloat();
+    stressOptions.frameTimeLimitMs = parser.isSet(stressLimitOption) ? parser.value(stressLimitOption).toFloat()
+                                                                     : 1000.0f / qMax(parser.value(targetFpsOption).toFloat(), 1.0f);
+
+    if(parser.isSet(stressOption) && (stressOptions.launchRate <= 0.0f || stressOptions.rampStep < 0.0f || stressOptions.stepSeconds <= 0.0f
+                                      || stressOptions.frameTimeLimitMs <= 0.0f || !parsePattern(parser.value(stressPatternOption), stressOptions.pattern))) {
+        qCritical("Invalid stress test options!");
+        return 1;
+    }
+
+    // Stress test and remote launches bypass the mouse and would be missing from the log
+    if(parser.isSet(listenOption) && parser.isSet(recordOption)) {
+        qCritical("Remote launches cannot be recorded!");
+        return 1;
+    }
+
+    if(parser.isSet(stressOption) && (parser.isSet(recordOption) || parser.isSet(replayOption))) {
+        qCritical("The stress test cannot be recorded or replayed!");
+        return 1;
+    }
+
+    // A show is a launch source of its own, mixing it with another one makes neither reproducible
+    if(parser.isSet(showOption) && (parser.isSet(stressOption) || parser.isSet(recordOption) || parser.isSet(replayOption))) {
+        qCritical("The show cannot be combined with the stress test, recording or replay!");
+        return 1;
+    }
+
+    QString audioSink = parser.value(audioOption);
+
+    bool headless = parser.isSet(benchmarkOption) || parser.isSet(replayOption);
+
+    if(audioSink.isEmpty())
+        audioSink = headless ? QStringLiteral("null") : QStringLiteral("device");
+
+    AudioEngine::instance().start(AudioEngine::sinkFromString(audioSink), audioSink);
+
+    if(headless) {
+        BenchmarkOptions options;
+        options.frames = parser.value(benchmarkOption).toUInt();
+        options.warmupFrames = parser.value(warmupOption).toUInt();
+        options.seed = parser.value(seedOption).toUInt();
+        options.launchInterval = parser.value(launchIntervalOption).toUInt();
+        options.dumpFileName = parser.value(dumpFrameOption);
+        options.captureFileName = parser.value(captureOption);
+        options.vramBudgetMb = parser.value(vramBudgetOption).toUInt();
+        options.targetFps = parser.value(targetFpsOption).toFloat();
+        options.simulation = simulation;
+        options.checkSimulation = parser.isSet(checkSimulationOption);
+        options.particleBudget = parser.value(particleBudgetOption).toUInt();
+        options.replayFileName = parser.value(replayOption);
+        options.timingsFileName = parser.value(timingsOption);
+        options.stress = parser.isSet(stressOption);
+        options.stressOptions = stressOptions;
+        options.showFileName = parser.value(showOption);
+
+        // Measurements stay comparable only at a fixed resolution, unless scaling is asked for explicitly
+        if(parser.isSet(renderScaleOption)) {
+            options.minRenderScale = minRenderScale;
+            options.maxRenderScale = maxRenderScale;
+        }
+
+        if((!options.frames && options.replayFileName.isEmpty()) || !parseSize(parser.value(sizeOption), options.width, options.height)) {
+            qCritical("Invalid benchmark options!");
+            AudioEngine::instance().stop();
+            return 1;
+        }
+
+        result = Benchmark(options).run();
+    } else {
+        Window window(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+        if(parser.isSet(captureOption)) {
+            window.setCaptureFile(parser.value(captureOption), FrameCapture::formatFromFileName(parser.value(captureOption)));
+        }
+
+        window.renderer().resourceManager().memory().setBudget(qint64(parser.value(vramBudgetOption).toUInt()) * 1048576);
+        window.renderer().resolutionScaler().setBounds(minRenderScale, maxRenderScale);
+        window.renderer().resolutionScaler().setTargetFrameRate(parser.value(targetFpsOption).toFloat());
+        window.renderer().setSimulationMode(simulation);
+        window.renderer().setSimulationCheck(parser.isSet(checkSimulationOption));
+        window.renderer().particleBudget().setBudget(parser.isSet(particleBudgetOption) ? parser.value(particleBudgetOption).toInt() : 20000);
+
+        InputLog inputLog;
+
+        // The whole show follows from the seed and the launches, a given --seed makes the session repeatable
+        if(parser.isSet(recordOption)) {
+            uint seed = parser.isSet(seedOption) ? parser.value(seedOption).toUInt() : (uint)QDateTime::currentMSecsSinceEpoch();
+
+            qsrand(seed);
+            inputLog.startRecording(seed, SCREEN_WIDTH, SCREEN_HEIGHT, simulation, window.renderer().particleBudget().budget());
+            window.setInputLog(&inputLog);
+        }
+
+        if(parser.isSet(stressOption))
+            window.stressTest().start(stressOptions);
+
+        if(parser.isSet(showOption)) {
+            if(!window.showScheduler().open(parser.value(showOption))) {
+                qCritical("Invalid show file!");
+                AudioEngine::instance().stop();
+                return 1;
+            }
+
+            window.showScheduler().start(window.renderer().renderedFrames());
+        }
+
+        if(parser.isSet(listenOption))
+            window.launchServer().start(parser.value(listenOption));
+
+        window.show();
+
+        result = app->exec();
+
+        window.launchServer().stop();
+
+        if(window.stressTest().isRunning())
+            qDebug() << QStringLiteral("StressTest:") << window.stressTest().report();
+
+        if(inputLog.isRecording())
+            inputLog.save(parser.value(recordOption), window.renderer().renderedFrames());
+    }
+
+    AudioEngine::instance().stop();
+
+    TRACE_FLUSH(QStringLiteral("trace.json"));
+
+    return result;
 }
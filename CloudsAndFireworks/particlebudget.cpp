@@ -0,0 +1,113 @@
+#include "particlebudget.h"
+
+ParticleBudget::ParticleBudget()
+    : m_budget(0)
+    , m_live(0)
+    , m_reserved(0)
+    , m_peak(0)
+    , m_reducedRequests(0)
+{
+}
+
+void ParticleBudget::setBudget(int particles)
+{
+    m_budget = qMax(particles, 0);
+}
+
+int ParticleBudget::budget() const
+{
+    return m_budget;
+}
+
+void ParticleBudget::beginFrame(int liveParticles)
+{
+    // Bursts requested in the previous frame are part of the live count by now
+    m_live = liveParticles;
+    m_reserved = 0;
+    m_peak = qMax(m_peak, liveParticles);
+}
+
+ParticleAllowance ParticleBudget::request(uint levels, uint maxTail)
+{
+    ParticleAllowance allowance(levels, maxTail, 1);
+
+    if(!m_budget)
+        return allowance;
+
+    int available = m_budget - m_live - m_reserved;
+    bool reduced = false;
+
+    // Trails are the cheapest to lose, rings change the look of the firework and go last
+    while(burstCost(allowance.levels, allowance.maxTail) > available) {
+        if(allowance.maxTail > MIN_TAIL)
+            allowance.maxTail = qMax(MIN_TAIL, allowance.maxTail * 3 / 4);
+        else if(allowance.levels > MIN_LEVELS)
+            --allowance.levels;
+        else
+            break;
+
+        reduced = true;
+    }
+
+    m_reserved += burstCost(allowance.levels, allowance.maxTail);
+
+    // Under pressure only every second or third trail sample is drawn
+    float load = pressure();
+    if(allowance.maxTail)
+        allowance.tailStride = load > 0.9f ? 3 : (load > 0.75f ? 2 : 1);
+
+    if(reduced || allowance.tailStride > 1)
+        ++m_reducedRequests;
+
+    return allowance;
+}
+
+uint ParticleBudget::requestRocketTail(uint maxTail)
+{
+    if(!m_budget)
+        return maxTail;
+
+    uint allowed = maxTail;
+    float load = pressure();
+
+    if(load > 0.75f)
+        allowed = qMax(MIN_ROCKET_TAIL, uint(maxTail * qMax(0.0f, 1.0f - load) * 4.0f));
+
+    m_reserved += allowed + 1;
+
+    if(allowed < maxTail)
+        ++m_reducedRequests;
+
+    return allowed;
+}
+
+int ParticleBudget::burstCost(uint levels, uint maxTail)
+{
+    // Ring i has 1 + 3i particles plus i more every second firework, every particle carries its trail
+    int particles = 0;
+
+    for(uint i = 0; i < levels; ++i)
+        particles += 1 + 3 * i + i / 2;
+
+    return particles * (maxTail + 1);
+}
+
+int ParticleBudget::live() const
+{
+    return m_live;
+}
+
+int ParticleBudget::peak() const
+{
+    return m_peak;
+}
+
+float ParticleBudget::pressure() const
+{
+    return m_budget ? float(m_live + m_reserved) / m_budget : 0.0f;
+}
+
+uint ParticleBudget::reducedRequests() const
+{
+    return m_reducedRequests;
+}
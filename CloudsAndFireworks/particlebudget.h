@@ -0,0 +1,72 @@
+#ifndef PARTICLEBUDGET_H
+#define PARTICLEBUDGET_H
+
+#include <QtGlobal>
+
+/*! Разрешённые залпу параметры: число колец, длина следа и шаг, с которым рисуются точки следа. */
+struct ParticleAllowance
+{
+    uint levels;
+    uint maxTail;
+    uint tailStride;
+
+    ParticleAllowance(uint levels = 0, uint maxTail = 0, uint tailStride = 1)
+        : levels(levels)
+        , maxTail(maxTail)
+        , tailStride(tailStride) {}
+};
+
+/*!
+  @brief Класс бюджета частиц.
+
+  Следит за количеством живых частиц всех фейерверков, включая точки следов. Новые залпы и ракеты
+  запрашивают разрешение: при нехватке бюджета сначала укорачиваются следы, потом убираются кольца,
+  а рисование следов прореживается, чтобы время кадра оставалось ограниченным при массовых запусках.
+  */
+
+
+class ParticleBudget
+{
+
+public:
+    /*! Конструктор класса ParticleBudget. */
+    ParticleBudget();
+
+    /*! Задаёт бюджет в частицах. 0 отключает ограничение. */
+    void setBudget(int particles);
+    int budget() const;
+
+    /*! Начинает кадр с <i>liveParticles</i> живыми частицами. Вызывать раз в кадр до запуска залпов. */
+    void beginFrame(int liveParticles);
+
+    /*! Запрашивает залп из <i>levels</i> колец со следом длины <i>maxTail</i>. Возвращает разрешённые параметры. */
+    ParticleAllowance request(uint levels, uint maxTail);
+
+    /*! Запрашивает след ракеты длины <i>maxTail</i>. Возвращает разрешённую длину. */
+    uint requestRocketTail(uint maxTail);
+
+    /*! Возвращает оценку количества частиц залпа. */
+    static int burstCost(uint levels, uint maxTail);
+
+    int live() const;
+    int peak() const;
+
+    /*! Возвращает заполнение бюджета с учётом залпов, запрошенных в этом кадре. */
+    float pressure() const;
+
+    /*! Возвращает количество уменьшенных залпов и ракет. */
+    uint reducedRequests() const;
+
+private:
+    static const uint MIN_LEVELS = 2;
+    static const uint MIN_TAIL = 6;
+    static const uint MIN_ROCKET_TAIL = 8;
+
+    int m_budget;
+    int m_live;
+    int m_reserved;
+    int m_peak;
+    uint m_reducedRequests;
+};
+
+#endif // PARTICLEBUDGET_H
@@ -0,0 +1,40 @@
+#include "particleeffect.h"
+#include <cmath>
+
+RingEmitter::RingEmitter(const QVector2D &origin, uint levels, float angleOffset, const GLColor &color)
+    : m_origin(origin)
+    , m_levels(levels)
+    , m_angleOffset(angleOffset)
+    , m_color(color)
+{
+}
+
+void RingEmitter::spawn(QVector<Particle> &particles, FireworkRandom &random) const
+{
+    uint particlesOnLevel;
+    float angle, speed, verticalVelocity, horizontalVelocity;
+
+    for (uint i = 0; i < m_levels; ++i) {
+
+        particlesOnLevel = 1 + 3 * i + (random.next() % 2) * i;
+        speed = (0.1f + (float)i) + ((float)random.next() / (float)RAND_MAX) * 0.1f;
+
+        for (uint j = 0; j < particlesOnLevel; ++j) {
+
+            angle = (360.0f / particlesOnLevel) * (float)j + (360.0f / particlesOnLevel / 2.0f) * (i % 2) + m_angleOffset;
+
+            horizontalVelocity = speed * cosf(angle / 180.0f * M_PI) * (1.0f + 0.2f * ((float)random.next() / (float)RAND_MAX));
+            verticalVelocity = speed * sinf(angle / 180.0f * M_PI) * (1.0f + 0.2f * ((float)random.next() / (float)RAND_MAX));
+
+            if(fabs(horizontalVelocity) < 0.001)
+                horizontalVelocity = 0.0f;
+
+            if(fabs(verticalVelocity) < 0.001)
+                verticalVelocity = 0.0f;
+
+            particles << Particle(m_origin.x(), m_origin.y());
+            particles.last().setVelocity(verticalVelocity, horizontalVelocity);
+            particles.last().setColor(m_color);
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef PARTICLEEFFECT_H
+#define PARTICLEEFFECT_H
+
+#include "firework.h"
+
+/*! Сдвигает частицу на её скорость. */
+class Motion
+{
+public:
+    void apply(Particle &particle) const
+    {
+        particle.setPosition(particle.getPosition() + particle.getVelocity());
+    }
+};
+
+/*! Не даёт частице опуститься ниже земли <i>ground</i>. */
+class GroundClamp
+{
+public:
+    explicit GroundClamp(float ground)
+        : m_ground(ground) {}
+
+    void apply(Particle &particle) const
+    {
+        const QVector2D &position = particle.getPosition();
+        particle.setPosition(position.x(), qMax(position.y(), m_ground));
+    }
+
+private:
+    float m_ground;
+};
+
+/*! Гасит скорость частицы в <i>damping</i> раз за шаг. */
+class Drag
+{
+public:
+    explicit Drag(float damping)
+        : m_damping(damping) {}
+
+    void apply(Particle &particle) const
+    {
+        particle.setVelocity(particle.getVelocity() * m_damping);
+    }
+
+private:
+    float m_damping;
+};
+
+/*! Уменьшает вертикальную скорость частицы на <i>acceleration</i> за шаг. */
+class Gravity
+{
+public:
+    explicit Gravity(float acceleration)
+        : m_acceleration(acceleration) {}
+
+    void apply(Particle &particle) const
+    {
+        const QVector2D &velocity = particle.getVelocity();
+        particle.setVelocity(velocity.x(), velocity.y() - m_acceleration);
+    }
+
+private:
+    float m_acceleration;
+};
+
+/*! Случайно зажигает или гасит частицу, числа берутся из <i>random</i> по одному на частицу. */
+class Blink
+{
+public:
+    explicit Blink(FireworkRandom &random)
+        : m_random(&random) {}
+
+    void apply(Particle &particle) const
+    {
+        GLColor color = particle.getColor();
+        color.alpha = (float)(m_random->next() % 2);
+        particle.setColor(color);
+    }
+
+private:
+    FireworkRandom *m_random;
+};
+
+/*! Вычитает из цвета частицы <i>step</i> за шаг. */
+class Fade
+{
+public:
+    explicit Fade(const GLColor &step)
+        : m_step(step) {}
+
+    void apply(Particle &particle) const
+    {
+        GLColor color = particle.getColor();
+        color.red -= m_step.red;
+        color.green -= m_step.green;
+        color.blue -= m_step.blue;
+        color.alpha -= m_step.alpha;
+        particle.setColor(color);
+    }
+
+private:
+    GLColor m_step;
+};
+
+/*!
+  @brief Шаблон цепочки аффекторов частиц.
+
+  Аффекторы задаются параметрами шаблона и применяются к каждой частице по порядку. Для каждого набора
+  получается свой цикл, в который аффекторы встраиваются без виртуальных вызовов и ветвлений по типу.
+  */
+
+
+template<typename... Affectors>
+class ParticleAffectors;
+
+template<>
+class ParticleAffectors<>
+{
+public:
+    void apply(Particle &) const {}
+};
+
+template<typename First, typename... Rest>
+class ParticleAffectors<First, Rest...>
+{
+public:
+    explicit ParticleAffectors(const First &first, const Rest &... rest)
+        : m_first(first)
+        , m_rest(rest...) {}
+
+    /*! Применяет все аффекторы к частице <i>particle</i>. */
+    void apply(Particle &particle) const
+    {
+        m_first.apply(particle);
+        m_rest.apply(particle);
+    }
+
+    /*! Применяет все аффекторы к частицам от <i>begin</i> до <i>end</i>. */
+    void update(Particle *begin, Particle *end) const
+    {
+        for (Particle *particle = begin; particle != end; ++particle)
+            apply(*particle);
+    }
+
+private:
+    First m_first;
+    ParticleAffectors<Rest...> m_rest;
+};
+
+/*!
+  @brief Класс эмиттера колец.
+
+  Выпускает залп из <i>levels</i> колец вокруг точки <i>origin</i>: в каждом следующем кольце больше частиц
+  и выше скорость, соседние кольца сдвинуты на половину шага.
+  */
+
+
+class RingEmitter
+{
+
+public:
+    /*! Конструктор класса RingEmitter. */
+    RingEmitter(const QVector2D &origin, uint levels, float angleOffset, const GLColor &color);
+
+    /*! Дописывает частицы залпа в <i>particles</i>, случайные числа берутся из <i>random</i>. */
+    void spawn(QVector<Particle> &particles, FireworkRandom &random) const;
+
+private:
+    QVector2D m_origin;
+    uint m_levels;
+    float m_angleOffset;
+    GLColor m_color;
+};
+
+#endif // PARTICLEEFFECT_H
@@ -0,0 +1,805 @@
+#include "renderer.h"
+#include "tracer.h"
+#include "audioengine.h"
+#include <QCoreApplication>
+
+Renderer::Renderer(uint width, uint height)
+    : m_width(width)
+    , m_height(height)
+    , m_frameCount(0)
+    , m_renderedFrames(0)
+    , m_cloudProgram(NULL)
+    , m_waterProgram(NULL)
+    , m_compositeProgram(NULL)
+    , m_backgroundTexture(NULL)
+    , m_circleParticleTexture(NULL)
+    , m_starParticleTexture(NULL)
+    , m_explosionTexture(NULL)
+    , m_vertexBuffer(NULL)
+    , m_ribbonBuffer(NULL)
+    , m_spriteBuffer(NULL)
+    , m_sceneTarget(NULL)
+    , m_cloudTarget(NULL)
+    , m_simulationMode(SimulationModes::Cpu)
+    , m_simulationStep(0)
+    , m_gpuSimulationError(0.0f)
+    , m_gpuSimulationChecked(false)
+    , m_captureFormat(CaptureFormats::Rgba)
+{
+    for (int i = 0; i < (int)SpriteBatches::Count; ++i) {
+        m_spriteFirsts[i] = 0;
+        m_spriteCounts[i] = 0;
+    }
+}
+
+Renderer::~Renderer()
+{
+    m_frameCapture.stop(m_resourceManager.state());
+
+    m_vao.destroy();
+    m_spriteVao.destroy();
+    qDeleteAll(m_cloudTextures);
+}
+
+void Renderer::initialize()
+{
+    TRACE_SCOPE("Renderer::initialize");
+
+    // Textures found in the pack are uploaded straight from the mapped file and are not decoded
+    m_resourceManager.loadAssetPack(QCoreApplication::applicationDirPath() + QStringLiteral("/assets.pak"));
+
+    // Images are decoded on worker threads while the clouds and shaders are created here
+    m_resourceManager.preloadTextures(QStringList() << ":/images/background.png"
+                                                    << ":/images/circleParticle.png"
+                                                    << ":/images/starParticle.png"
+                                                    << ":/images/explosion.png");
+
+    initializeOpenGLFunctions();
+
+    glDisable(GL_DEPTH_TEST);
+
+    m_resourceManager.init();
+
+    m_vao.create();
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+
+    m_vertexBuffer = m_resourceManager.createVertexBuffer(4 * sizeof(VertexData));
+
+    m_resourceManager.bindVertexBuffer(m_vertexBuffer);
+
+    m_vertexData.clear();
+    m_vertexData << VertexData(QVector3D(0.0f, 0.0f, 0.0f), QVector2D(0.0f, 0.0f))
+                 << VertexData(QVector3D(1.0f, 0.0f, 0.0f), QVector2D(1.0f, 0.0f))
+                 << VertexData(QVector3D(0.0f, 1.0f, 0.0f), QVector2D(0.0f, 1.0f))
+                 << VertexData(QVector3D(1.0f, 1.0f, 0.0f), QVector2D(1.0f, 1.0f));
+
+    m_vertexBuffer->write(0, m_vertexData.data(), m_vertexData.size() * sizeof(VertexData));
+
+    m_ribbonBuffer = m_resourceManager.createVertexBuffer(4096 * sizeof(VertexData), NULL, QOpenGLBuffer::StreamDraw);
+
+    // Point sprites have their own vertex layout, it is recorded once in a separate VAO
+    m_spriteBuffer = m_resourceManager.createVertexBuffer(4096 * sizeof(PointSpriteData), NULL, QOpenGLBuffer::StreamDraw);
+
+    m_spriteVao.create();
+    m_resourceManager.state().bindVertexArray(m_spriteVao.objectId());
+    m_resourceManager.state().bindBuffer(GL_ARRAY_BUFFER, m_spriteBuffer->bufferId());
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(PointSpriteData), (const void *)offsetof(PointSpriteData, position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(PointSpriteData), (const void *)offsetof(PointSpriteData, size));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(PointSpriteData), (const void *)offsetof(PointSpriteData, angle));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(PointSpriteData), (const void *)offsetof(PointSpriteData, color));
+    for (GLuint i = 0; i < 4; ++i)
+        glEnableVertexAttribArray(i);
+
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+
+    QOpenGLTexture *cloudTexture;
+
+    for(int i = 32; i < 1024; i *= 2) {
+        cloudTexture = new QOpenGLTexture(m_cloud.createCloud(i, 0.7, 0.05, 0.9));
+        cloudTexture->setWrapMode(QOpenGLTexture::MirroredRepeat);
+        m_cloudTextures << cloudTexture;
+        m_resourceManager.memory().registerTexture(cloudTexture, QStringLiteral("Cloud %1").arg(i));
+    }
+
+    m_cloudProgram = m_resourceManager.createShaderProgram(":/shaders/clouds.frag", ":/shaders/default.vert");
+
+    m_fireworkPrograms.clear();
+    m_fireworkPrograms << m_resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/default.vert", "", QStringList() << "MODE EXPLOSION")
+                       << m_resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/pointsprite.vert", ":/shaders/pointsprite.geom", QStringList() << "MODE BLINKS" << "POINT_SPRITES")
+                       << m_resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/pointsprite.vert", ":/shaders/pointsprite.geom", QStringList() << "MODE SNAKES" << "POINT_SPRITES")
+                       << m_resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/default.vert", "", QStringList() << "MODE RIBBONS");
+    m_waterProgram = m_resourceManager.createShaderProgram(":/shaders/water.frag", ":/shaders/default.vert");
+    m_compositeProgram = m_resourceManager.createShaderProgram(":/shaders/default.frag", ":/shaders/default.vert", "", QStringList() << "SCALED_TEXCOORDS");
+
+    m_gpuParticles[(int)FireworkTypes::Blinks].init(m_resourceManager, FireworkTypes::Blinks, QStringLiteral("GPU blinks"));
+    m_gpuParticles[(int)FireworkTypes::Snakes].init(m_resourceManager, FireworkTypes::Snakes, QStringLiteral("GPU snakes"));
+    m_analyticParticles[(int)FireworkTypes::Blinks].init(m_resourceManager, FireworkTypes::Blinks);
+    m_analyticParticles[(int)FireworkTypes::Snakes].init(m_resourceManager, FireworkTypes::Snakes);
+
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+
+    m_resourceManager.uploadPreloadedTextures();
+
+    m_backgroundTexture = m_resourceManager.texture(":/images/background.png");
+    m_circleParticleTexture = m_resourceManager.texture(":/images/circleParticle.png");
+    m_starParticleTexture = m_resourceManager.texture(":/images/starParticle.png");
+    m_explosionTexture = m_resourceManager.texture(":/images/explosion.png");
+
+    if(!m_captureFileName.isEmpty() && m_frameCapture.start(m_captureFileName, m_captureFormat, m_width, m_height, m_resourceManager.state()))
+        m_resourceManager.memory().registerAllocation(&m_frameCapture, GpuMemoryCategories::Buffers, QStringLiteral("FrameCapture"),
+                                                      QStringLiteral("PBO"), m_frameCapture.bufferBytes());
+
+    // QOpenGLTexture binds the textures it creates behind the state cache, from here on the cache is kept across frames
+    m_resourceManager.state().invalidate();
+}
+
+void Renderer::render(GLuint targetFramebuffer)
+{
+    TRACE_SCOPE("Renderer::render");
+
+    FrameProfiler &profiler = m_resourceManager.profiler();
+    GLStateCache &state = m_resourceManager.state();
+
+    profiler.beginFrame();
+    state.beginFrame();
+
+    m_resolutionScaler.update(profiler.latest());
+
+    // The layers are drawn at the scaled resolution and stretched to the full size by the composite and water passes
+    QSize layerSize(qMax(1, qRound(m_width * m_resolutionScaler.scale())), qMax(1, qRound(m_height * m_resolutionScaler.scale())));
+
+    // Layers are taken from the pool every frame, so a resize only reallocates them when they no longer fit
+    RenderTargetPool &renderTargets = m_resourceManager.renderTargets();
+    renderTargets.beginFrame();
+    m_sceneTarget = renderTargets.acquire(layerSize);
+    m_cloudTarget = renderTargets.acquire(layerSize);
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    state.viewport(0, 0, m_width, m_height);
+
+    state.bindVertexArray(m_vao.objectId());
+    m_resourceManager.setupGLState();
+    m_resourceManager.bindVertexBuffer(m_vertexBuffer);
+
+
+    profiler.beginPass(ProfilerPasses::Background);
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, m_sceneTarget->framebuffer->handle());
+    state.viewport(0, 0, layerSize.width(), layerSize.height());
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    drawBackground();
+
+    profiler.endPass();
+    profiler.beginPass(ProfilerPasses::Fireworks);
+
+    // Trails drawn from their spawn parameters outlive the firework that emitted them
+    if(m_fireworks.size() || gpuParticlesCount())
+        drawFireworks();
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+    profiler.endPass();
+
+
+    profiler.beginPass(ProfilerPasses::CloudsFbo);
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, m_cloudTarget->framebuffer->handle());
+    state.viewport(0, 0, layerSize.width(), layerSize.height());
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    drawClouds();
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    state.viewport(0, 0, m_width, m_height);
+
+    profiler.endPass();
+
+
+    profiler.beginPass(ProfilerPasses::Composite);
+
+    drawComposite();
+    drawClouds();
+
+    profiler.endPass();
+
+
+    profiler.beginPass(ProfilerPasses::Water);
+
+    drawWater();
+
+    profiler.endPass();
+
+    renderTargets.release(m_sceneTarget);
+    renderTargets.release(m_cloudTarget);
+
+    m_frameCapture.captureFrame(targetFramebuffer, state);
+
+    state.endFrame();
+    profiler.endFrame();
+
+    ++m_renderedFrames;
+}
+
+void Renderer::advanceFrame()
+{
+    ++m_frameCount;
+}
+
+void Renderer::resize(int width, int height)
+{
+    if(width > 0 && height > 0) {
+        m_resourceManager.state().viewport(0, 0, width, height);
+        m_matrixStack.projection().setToIdentity();
+        m_matrixStack.projection().ortho(0.0f, width, 0.0f, height, -1.0f, 1.0f);
+
+        m_width = (uint)width;
+        m_height = (uint)height;
+    }
+}
+
+void Renderer::launchFirework(const QPointF &position)
+{
+    m_fireworks << Firework(position.x(), m_height - position.y() * 1.1667f - 28.0f, &m_particleBudget);
+}
+
+void Renderer::launchFirework(const QPointF &position, const FireworkParams &params)
+{
+    m_fireworks << Firework(position.x(), m_height - position.y() * 1.1667f - 28.0f, &m_particleBudget, &params);
+}
+
+ParticleBudget &Renderer::particleBudget()
+{
+    return m_particleBudget;
+}
+
+void Renderer::restoreGLState()
+{
+    m_resourceManager.restoreGLState();
+    m_resourceManager.state().bindVertexArray(0);
+}
+
+void Renderer::setCaptureFile(const QString &fileName, CaptureFormats format)
+{
+    m_captureFileName = fileName;
+    m_captureFormat = format;
+}
+
+ResourceManager &Renderer::resourceManager()
+{
+    return m_resourceManager;
+}
+
+ResolutionScaler &Renderer::resolutionScaler()
+{
+    return m_resolutionScaler;
+}
+
+void Renderer::setSimulationMode(SimulationModes mode)
+{
+    m_simulationMode = mode;
+}
+
+SimulationModes Renderer::simulationMode() const
+{
+    return m_simulationMode;
+}
+
+QString Renderer::simulationModeName(SimulationModes mode)
+{
+    switch(mode) {
+    case SimulationModes::Cpu:
+        return QStringLiteral("cpu");
+    case SimulationModes::Gpu:
+        return QStringLiteral("gpu");
+    case SimulationModes::Analytic:
+        return QStringLiteral("analytic");
+    default:
+        return QString();
+    }
+}
+
+void Renderer::setSimulationCheck(bool enabled)
+{
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_gpuParticles[i].setCheckEnabled(enabled);
+}
+
+GpuParticleSystem &Renderer::gpuParticles(FireworkTypes type)
+{
+    return m_gpuParticles[(int)type];
+}
+
+AnalyticParticleSystem &Renderer::analyticParticles(FireworkTypes type)
+{
+    return m_analyticParticles[(int)type];
+}
+
+uint Renderer::width() const
+{
+    return m_width;
+}
+
+uint Renderer::height() const
+{
+    return m_height;
+}
+
+uint Renderer::frameCount() const
+{
+    return m_frameCount;
+}
+
+uint Renderer::renderedFrames() const
+{
+    return m_renderedFrames;
+}
+
+int Renderer::fireworksCount() const
+{
+    return m_fireworks.size();
+}
+
+float Renderer::gpuSimulationError() const
+{
+    return m_gpuSimulationError;
+}
+
+int Renderer::gpuParticlesCount() const
+{
+    int result = 0;
+
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        result += m_gpuParticles[i].count() + m_analyticParticles[i].count();
+
+    return result;
+}
+
+void Renderer::drawBackground()
+{
+    m_resourceManager.bindDefaultShaderProgram();
+
+    m_matrixStack.push(Model);
+    m_matrixStack.model().scale(m_width, m_height);
+
+    m_resourceManager.bindTexture(m_backgroundTexture);
+    m_resourceManager.defaultShaderProgram()->setUniformValue("tex", 0);
+
+    m_resourceManager.defaultShaderProgram()->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+    m_matrixStack.pop(Model);
+}
+
+void Renderer::drawClouds()
+{
+    m_resourceManager.bindShaderProgram(m_cloudProgram);
+
+    m_matrixStack.push(Model);
+    m_matrixStack.model().translate(0.0f, m_height - m_height/1.7f);
+    m_matrixStack.model().scale(m_width, m_height/1.7f);
+
+    m_resourceManager.bindTexture(m_cloudTextures[0], GL_TEXTURE0);
+    m_cloudProgram->setUniformValue("tex1", 0);
+    m_resourceManager.bindTexture(m_cloudTextures[1], GL_TEXTURE1);
+    m_cloudProgram->setUniformValue("tex2", 1);
+    m_resourceManager.bindTexture(m_cloudTextures[2], GL_TEXTURE2);
+    m_cloudProgram->setUniformValue("tex3", 2);
+    m_resourceManager.bindTexture(m_cloudTextures[3], GL_TEXTURE3);
+    m_cloudProgram->setUniformValue("tex4", 3);
+    m_resourceManager.bindTexture(m_cloudTextures[4], GL_TEXTURE4);
+    m_cloudProgram->setUniformValue("tex5", 4);
+
+    m_cloudProgram->setUniformValue("offset", (float)m_frameCount/(float)m_width);
+
+    m_cloudProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+    m_matrixStack.pop(Model);
+}
+
+void Renderer::drawFireworks()
+{
+    TRACE_SCOPE("Renderer::drawFireworks");
+
+    // Every firework mode has its own shader variant, so draws are grouped by mode instead of by firework
+    buildSprites();
+
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_analyticParticles[i].update(m_simulationStep);
+
+    drawSprites(SpriteBatches::Rockets, FireworkModes::Snakes, m_circleParticleTexture);
+    drawExplosions();
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_analyticParticles[i].drawExplosions(m_matrixStack.getCopy(ModelViewProjection), m_explosionTexture);
+
+    drawTrailRibbons();
+
+    drawSprites(SpriteBatches::Snakes, FireworkModes::Snakes, m_starParticleTexture);
+    drawSprites(SpriteBatches::Blinks, FireworkModes::Blinks, m_starParticleTexture);
+    drawGpuParticles();
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_analyticParticles[i].draw(m_matrixStack.getCopy(ModelViewProjection), m_starParticleTexture);
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+
+    updateFireworks();
+}
+
+void Renderer::drawExplosions()
+{
+    QOpenGLShaderProgram *program = m_fireworkPrograms[(int)FireworkModes::Explosion];
+
+    m_resourceManager.bindShaderProgram(program);
+    program->setUniformValue("tex", 0);
+    m_resourceManager.bindTexture(m_explosionTexture);
+
+    QVector2D position, offset;
+
+    for (int i = 0; i < m_fireworks.size(); ++i) {
+
+        // Fireworks simulated on the GPU have no particles left here, so the explosion follows the state
+        if(m_fireworks.at(i).getCurrentFireworkState() != FireworkStates::Launched && !(m_fireworks.at(i).isExplosionFinished())) {
+
+            position = m_fireworks.at(i).getExplosionPosition();
+            offset = m_fireworks.at(i).calculateSpriteOffset();
+
+            m_matrixStack.push(Model);
+            m_matrixStack.model().translate(position.x(), position.y());
+            m_matrixStack.model().scale(70.0f, 70.0f);
+            m_matrixStack.model().translate(-0.5f, -0.5f);
+
+            program->setUniformValue("spriteOffset", offset);
+            program->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+            m_matrixStack.pop(Model);
+        }
+    }
+}
+
+void Renderer::buildSprites()
+{
+    TRACE_SCOPE("Renderer::buildSprites");
+
+    // resize() keeps the capacity of the previous frames, clear() would release it
+    m_spriteData.resize(0);
+
+    int count = 0;
+
+    for (int i = 0; i < m_fireworks.size(); ++i)
+        count += m_fireworks.at(i).getRocketParticlesQuantity();
+
+    // Fireworks write their sprites straight into the vertex array, which is sized once per batch
+    m_spriteFirsts[(int)SpriteBatches::Rockets] = 0;
+    m_spriteData.resize(count);
+
+    PointSpriteData *output = m_spriteData.data();
+
+    for (int i = 0; i < m_fireworks.size(); ++i)
+        output += m_fireworks.at(i).writeRocketSprites(output);
+
+    m_spriteCounts[(int)SpriteBatches::Rockets] = count;
+
+    buildParticleSprites(FireworkTypes::Snakes, SpriteBatches::Snakes);
+    buildParticleSprites(FireworkTypes::Blinks, SpriteBatches::Blinks);
+
+    // Sprites of all batches go up in one upload, the batches only differ in the shader variant and texture
+    if(!m_spriteData.isEmpty())
+        m_resourceManager.streamVertexData(m_spriteBuffer, m_spriteData.constData(), m_spriteData.size() * sizeof(PointSpriteData));
+}
+
+void Renderer::buildParticleSprites(FireworkTypes type, SpriteBatches batch)
+{
+    // Snake trails are drawn by drawTrailRibbons(), only their heads stay sprites
+    bool headsOnly = (type == FireworkTypes::Snakes);
+    int first = m_spriteData.size(), count = 0;
+
+    for (int i = 0; i < m_fireworks.size(); ++i) {
+        if(m_fireworks.at(i).getType() == type)
+            count += m_fireworks.at(i).getParticleSpritesCount(headsOnly);
+    }
+
+    m_spriteFirsts[(int)batch] = first;
+    m_spriteData.resize(first + count);
+
+    PointSpriteData *output = m_spriteData.data() + first;
+
+    for (int i = 0; i < m_fireworks.size(); ++i) {
+        if(m_fireworks.at(i).getType() == type)
+            output += m_fireworks.at(i).writeParticleSprites(output, headsOnly);
+    }
+
+    m_spriteCounts[(int)batch] = count;
+}
+
+void Renderer::drawSprites(SpriteBatches batch, FireworkModes mode, QOpenGLTexture *texture)
+{
+    if(!m_spriteCounts[(int)batch])
+        return;
+
+    GLStateCache &state = m_resourceManager.state();
+
+    bindSpriteProgram(mode, texture);
+
+    // One point per sprite, the geometry shader expands it into a rotated quad
+    state.bindVertexArray(m_spriteVao.objectId());
+    glDrawArrays(GL_POINTS, m_spriteFirsts[(int)batch], m_spriteCounts[(int)batch]);
+    state.bindVertexArray(m_vao.objectId());
+}
+
+void Renderer::bindSpriteProgram(FireworkModes mode, QOpenGLTexture *texture)
+{
+    QOpenGLShaderProgram *program = m_fireworkPrograms[(int)mode];
+
+    m_resourceManager.bindShaderProgram(program);
+    program->setUniformValue("tex", 0);
+    program->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+    m_resourceManager.bindTexture(texture);
+}
+
+void Renderer::drawGpuParticles()
+{
+    // Trails go first, the heads are drawn over them like over the CPU ribbons
+    if(m_gpuParticles[(int)FireworkTypes::Snakes].count()) {
+        m_gpuParticles[(int)FireworkTypes::Snakes].drawTrails(m_matrixStack.getCopy(ModelViewProjection), m_starParticleTexture);
+        bindSpriteProgram(FireworkModes::Snakes, m_starParticleTexture);
+        m_gpuParticles[(int)FireworkTypes::Snakes].draw();
+    }
+
+    if(m_gpuParticles[(int)FireworkTypes::Blinks].count()) {
+        bindSpriteProgram(FireworkModes::Blinks, m_starParticleTexture);
+        m_gpuParticles[(int)FireworkTypes::Blinks].draw();
+    }
+
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+}
+
+void Renderer::emitGpuBurst(Firework &firework)
+{
+    ParticleSpan burst = firework.getBurst();
+    QVector<GpuParticle> particles;
+    particles.reserve(burst.size());
+
+    bool blink = (firework.getType() == FireworkTypes::Blinks);
+    QVector2D size(firework.getParticlesSize(), firework.getParticlesSize());
+    QVector2D velocity;
+
+    // Snakes stay alive until the end of the trail has faded, the trail is computed from the explosion parameters
+    GLfloat flightDuration = firework.getParticlesFlightDuration();
+    GLfloat maxTail = blink ? 0.0f : firework.getParticlesMaxTail();
+
+    for (int i = 0; i < burst.size(); ++i) {
+        velocity = burst.at(i).getVelocity();
+        particles << GpuParticle(burst.at(i).getPosition(), size, blink ? 0.0f : (GLfloat)atan2(-velocity.x(), velocity.y()),
+                                 burst.at(i).getColor(), velocity, flightDuration + maxTail, blink ? 1.0f : 0.0f,
+                                 TrajectoryData(burst.at(i).getPosition(), velocity, burst.at(i).getColor(), 0.0f,
+                                                flightDuration, maxTail, firework.getParticlesSize(), i));
+    }
+
+    m_gpuParticles[(int)firework.getType()].emitBurst(particles);
+    firework.detachParticles();
+}
+
+void Renderer::emitAnalyticBurst(Firework &firework)
+{
+    ParticleSpan burst = firework.getBurst();
+    QVector<TrajectoryData> particles;
+    particles.reserve(burst.size());
+
+    // The burst is drawn from the next frame on, like the CPU particles that are first drawn after the update
+    GLfloat spawnFrame = m_simulationStep + 1;
+    GLfloat blink = (firework.getType() == FireworkTypes::Blinks) ? 1.0f : 0.0f;
+
+    for (int i = 0; i < burst.size(); ++i) {
+        particles << TrajectoryData(burst.at(i).getPosition(), burst.at(i).getVelocity(), burst.at(i).getColor(), spawnFrame,
+                                    firework.getParticlesFlightDuration(), firework.getParticlesMaxTail(), firework.getParticlesSize(), i, blink);
+    }
+
+    m_analyticParticles[(int)firework.getType()].emitBurst(particles, firework.getExplosionPosition());
+    firework.detachParticles(true);
+}
+
+void Renderer::drawTrailRibbons()
+{
+    TRACE_SCOPE("Renderer::drawTrailRibbons");
+
+    // resize() keeps the capacity of the previous frames, clear() would release it
+    m_ribbonVertices.resize(0);
+    m_ribbonFirsts.resize(0);
+    m_ribbonCounts.resize(0);
+
+    for (int i = 0; i < m_fireworks.size(); ++i) {
+
+        const Firework &firework = m_fireworks.at(i);
+
+        if(firework.getType() != FireworkTypes::Snakes)
+            continue;
+
+        GLfloat width = firework.getParticlesSize();
+        int stride = firework.getParticlesTailStride();
+
+        for (uint j = 0; j < firework.getParticlesQuantity(); ++j)
+            buildTrailRibbon(firework.getTrail(j), width, stride);
+    }
+
+    if(m_ribbonCounts.isEmpty())
+        return;
+
+    QOpenGLShaderProgram *program = m_fireworkPrograms[(int)FireworkModes::Ribbons];
+
+    m_resourceManager.bindShaderProgram(program);
+    program->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    // All ribbons of the frame go up in one upload and one draw call
+    m_resourceManager.streamVertexData(m_ribbonBuffer, m_ribbonVertices.constData(), m_ribbonVertices.size() * sizeof(VertexData));
+    m_resourceManager.bindVertexBuffer(m_ribbonBuffer);
+
+    glMultiDrawArrays(GL_TRIANGLE_STRIP, m_ribbonFirsts.constData(), m_ribbonCounts.constData(), m_ribbonCounts.size());
+
+    m_resourceManager.bindVertexBuffer(m_vertexBuffer);
+}
+
+void Renderer::buildTrailRibbon(const TrailView &trail, GLfloat width, int stride)
+{
+    int count = trail.size();
+
+    if(count < 2)
+        return;
+
+    // Under budget pressure only every stride-th node is drawn, the end of the tail always is
+    int samples = (count - 2) / stride + 2;
+
+    m_ribbonFirsts << m_ribbonVertices.size();
+    m_ribbonCounts << samples * 2;
+
+    QVector2D position, direction, normal;
+    GLColor color;
+    GLfloat halfWidth;
+
+    for (int n = 0; n < samples; ++n) {
+        int k = (n == samples - 1) ? count - 1 : n * stride;
+
+        position = trail.position(k);
+
+        // The head is at index 0, the direction follows the neighbours and falls back to the velocity where they coincide
+        direction = trail.position(qMax(k - 1, 0)) - trail.position(qMin(k + 1, count - 1));
+        if(direction.lengthSquared() < 0.0001f)
+            direction = trail.velocity(k);
+        if(direction.lengthSquared() < 0.0001f)
+            direction = QVector2D(0.0f, 1.0f);
+
+        direction.normalize();
+        normal = QVector2D(-direction.y(), direction.x());
+
+        // Tapers from the full sprite width at the head to a fifth of it at the end of the tail
+        halfWidth = width * 0.5f * (1.0f - 0.8f * (float)k / (float)(count - 1));
+
+        color = trail.color(k);
+
+        m_ribbonVertices << VertexData(QVector3D(position + normal * halfWidth, 0.0f), QVector2D(0.0f, (float)k), color)
+                         << VertexData(QVector3D(position - normal * halfWidth, 0.0f), QVector2D(1.0f, (float)k), color);
+    }
+}
+
+void Renderer::updateFireworks()
+{
+    if(m_simulationMode == SimulationModes::Gpu && !m_gpuSimulationChecked)
+        checkGpuSimulation();
+
+    // GPU particles are stepped before new bursts are appended, CPU particles also start moving the frame after the explosion
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_gpuParticles[i].step(m_frameCount);
+
+    int liveParticles = gpuParticlesCount();
+    for (int i = 0; i < m_fireworks.size(); ++i)
+        liveParticles += m_fireworks.at(i).getLiveParticlesCount();
+    m_particleBudget.beginFrame(liveParticles);
+
+    for (int i = 0; i < m_fireworks.size(); ++i) {
+
+        switch(m_fireworks.at(i).getCurrentFireworkState()) {
+        case FireworkStates::Launched:
+            m_fireworks[i].moveRocket();
+            if(m_fireworks.at(i).isBurstPending()) {
+                bool gpu = (m_simulationMode == SimulationModes::Gpu) && (m_gpuSimulationError <= GpuParticleSystem::CHECK_TOLERANCE);
+
+                if(gpu)
+                    emitGpuBurst(m_fireworks[i]);
+                else if(m_simulationMode == SimulationModes::Analytic)
+                    emitAnalyticBurst(m_fireworks[i]);
+            }
+            break;
+        case FireworkStates::Exploded:
+            m_fireworks[i].destroyRocketTail();
+            m_fireworks[i].moveFireworkParticles();
+            break;
+        case FireworkStates::Faded:
+            m_fireworks[i].destroyParticlesTails();
+            break;
+        case FireworkStates::Finished:
+            m_fireworks.removeAt(i--);
+            break;
+        }
+    }
+
+    m_resourceManager.state().bindVertexArray(m_vao.objectId());
+
+    // All sounds of the frame reach the mixer together, the same sound only once
+    AudioEngine::instance().endFrame();
+
+    ++m_simulationStep;
+}
+
+void Renderer::checkGpuSimulation()
+{
+    // The GPU step is compared with the CPU the first time the GPU mode is used, before any burst is on the GPU.
+    // On a mismatch the GPU mode keeps the fireworks on the CPU.
+    for (int i = 0; i < (int)FireworkTypes::Count; ++i)
+        m_gpuSimulationError = qMax(m_gpuSimulationError, m_gpuParticles[i].selfCheck());
+
+    if(m_gpuSimulationError > GpuParticleSystem::CHECK_TOLERANCE)
+        qWarning() << QStringLiteral("Renderer: GPU simulation differs from the CPU by") << m_gpuSimulationError << QStringLiteral(", fireworks stay on the CPU!");
+
+    m_gpuSimulationChecked = true;
+}
+
+void Renderer::drawComposite()
+{
+    m_resourceManager.bindShaderProgram(m_compositeProgram);
+    m_resourceManager.bindTexture(m_sceneTarget->framebuffer->texture());
+    m_compositeProgram->setUniformValue("tex", 0);
+    m_compositeProgram->setUniformValue("texScale", m_sceneTarget->texScale());
+
+    m_matrixStack.push(Model);
+    m_matrixStack.model().translate(0.0f, m_height/6.0f);
+    m_matrixStack.model().scale(m_width, m_height/1.1667f);
+
+    m_compositeProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+    m_matrixStack.pop(Model);
+}
+
+void Renderer::drawWater()
+{
+    m_resourceManager.bindShaderProgram(m_waterProgram);
+
+    m_resourceManager.bindTexture(m_sceneTarget->framebuffer->texture());
+    m_waterProgram->setUniformValue("tex", 0);
+    m_waterProgram->setUniformValue("texScale", m_sceneTarget->texScale());
+
+    m_waterProgram->setUniformValue("angle", (float)m_frameCount * 5.0f);
+
+    m_matrixStack.push(Model);
+    m_matrixStack.model().translate(0.0f, m_height/6.0f);
+    m_matrixStack.model().scale(m_width, m_height/6.0f);
+    m_matrixStack.model().scale(1.0f, -1.0f);
+
+    m_waterProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+
+    m_matrixStack.pop(Model);
+
+    m_resourceManager.bindTexture(m_cloudTarget->framebuffer->texture());
+    m_waterProgram->setUniformValue("texScale", m_cloudTarget->texScale());
+    m_matrixStack.push(Model);
+    m_matrixStack.model().translate(0.0f, m_height/3.0f);
+    m_matrixStack.model().scale(m_width, m_height/3.0f);
+    m_matrixStack.model().scale(1.0f, -1.0f);
+
+    m_waterProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+
+    m_matrixStack.pop(Model);
+}
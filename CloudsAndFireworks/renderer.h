@@ -0,0 +1,186 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLFramebufferObject>
+#include <QPointF>
+#include "resourcemanager.h"
+#include "glmatrixstack.h"
+#include "cloud.h"
+#include "firework.h"
+#include "framecapture.h"
+#include "resolutionscaler.h"
+#include "gpuparticlesystem.h"
+#include "analyticparticlesystem.h"
+
+enum class SpriteBatches
+{
+    Rockets,
+    Snakes,
+    Blinks,
+    Count
+};
+
+/*!
+  @brief Класс отрисовщика сцены.
+
+  Владеет всеми ресурсами сцены и рисует кадр в заданный фреймбуффер.
+  Не зависит от окна, поэтому используется и в окне, и в безоконном режиме.
+  */
+
+
+class Renderer: protected QOpenGLFunctions_3_3_Core
+{
+
+public:
+    /*! Конструктор класса Renderer. */
+    explicit Renderer(uint width = 1280, uint height = 800);
+
+    /*! Деструктор класса Renderer. */
+    ~Renderer();
+
+    /*! Создаёт ресурсы сцены. Не вызывать до создания контекста! */
+    void initialize();
+
+    /*! Изменяет размер области отрисовки. */
+    void resize(int width, int height);
+
+    /*! Рисует кадр в фреймбуффер <i>targetFramebuffer</i>. */
+    void render(GLuint targetFramebuffer);
+
+    /*! Переходит к следующему кадру анимации. */
+    void advanceFrame();
+
+    /*! Запускает фейерверк в точку <i>position</i>, заданную в координатах окна. */
+    void launchFirework(const QPointF &position);
+
+    /*! Запускает фейерверк с параметрами <i>params</i> из сценария шоу. */
+    void launchFirework(const QPointF &position, const FireworkParams &params);
+
+    /*! Возвращает контекст в исходное состояние, например перед рисованием через QPainter. */
+    void restoreGLState();
+
+    /*!
+     * Включает запись готовых кадров в файл <i>fileName</i> в формате <i>format</i>.
+     * Запись начинается при инициализации, поэтому вызывать до initialize().
+     */
+    void setCaptureFile(const QString &fileName, CaptureFormats format);
+
+    /*! Возвращает менеджер ресурсов. */
+    ResourceManager &resourceManager();
+
+    /*! Возвращает бюджет частиц фейерверков. */
+    ParticleBudget &particleBudget();
+
+    /*! Возвращает регулятор разрешения слоёв сцены. */
+    ResolutionScaler &resolutionScaler();
+
+    /*!
+     * Выбирает, где симулируются частицы фейерверков. Действует на фейерверки, взорвавшиеся после вызова,
+     * уже летящие частицы досимулируются там, где начали.
+     */
+    void setSimulationMode(SimulationModes mode);
+    SimulationModes simulationMode() const;
+
+    /*! Возвращает имя режима симуляции <i>mode</i>, как оно задаётся в командной строке. */
+    static QString simulationModeName(SimulationModes mode);
+
+    /*! Включает сравнение симуляции на GPU с CPU. Вызывать до первого запуска. */
+    void setSimulationCheck(bool enabled);
+
+    /*! Возвращает симуляцию на GPU для фейерверков типа <i>type</i>. */
+    GpuParticleSystem &gpuParticles(FireworkTypes type);
+
+    /*! Возвращает частицы с траекториями в замкнутой форме для фейерверков типа <i>type</i>. */
+    AnalyticParticleSystem &analyticParticles(FireworkTypes type);
+
+    uint width() const;
+    uint height() const;
+    uint frameCount() const;
+
+    /*! Возвращает количество нарисованных кадров. Запуски до следующего render() попадают в кадр с этим номером. */
+    uint renderedFrames() const;
+    int fireworksCount() const;
+
+    /*! Возвращает расхождение симуляции на GPU с CPU на пробном залпе. Залп проверяется при первом кадре в режиме GPU. */
+    float gpuSimulationError() const;
+
+    /*! Возвращает количество частиц, которые живут только на GPU. */
+    int gpuParticlesCount() const;
+
+private:
+    void drawBackground();
+    void drawClouds();
+    void drawFireworks();
+    void drawExplosions();
+    void buildSprites();
+    void buildParticleSprites(FireworkTypes type, SpriteBatches batch);
+    void drawSprites(SpriteBatches batch, FireworkModes mode, QOpenGLTexture *texture);
+    void bindSpriteProgram(FireworkModes mode, QOpenGLTexture *texture);
+    void drawGpuParticles();
+    void emitGpuBurst(Firework &firework);
+    void emitAnalyticBurst(Firework &firework);
+    void drawTrailRibbons();
+    void buildTrailRibbon(const TrailView &trail, GLfloat width, int stride);
+    void updateFireworks();
+    void checkGpuSimulation();
+    void drawComposite();
+    void drawWater();
+
+    uint m_width;
+    uint m_height;
+    uint m_frameCount;
+    uint m_renderedFrames;
+
+    ResourceManager m_resourceManager;
+    QOpenGLShaderProgram *m_cloudProgram;
+    QVector<QOpenGLShaderProgram*> m_fireworkPrograms;
+    QOpenGLShaderProgram *m_waterProgram;
+    QOpenGLShaderProgram *m_compositeProgram;
+
+    QOpenGLTexture *m_backgroundTexture;
+    QVector<QOpenGLTexture*> m_cloudTextures;
+    QOpenGLTexture *m_circleParticleTexture;
+    QOpenGLTexture *m_starParticleTexture;
+    QOpenGLTexture *m_explosionTexture;
+
+    QOpenGLVertexArrayObject m_vao;
+    QVector<VertexData> m_vertexData;
+    QOpenGLBuffer *m_vertexBuffer;
+
+    QVector<VertexData> m_ribbonVertices;
+    QVector<GLint> m_ribbonFirsts;
+    QVector<GLsizei> m_ribbonCounts;
+    QOpenGLBuffer *m_ribbonBuffer;
+
+    QOpenGLVertexArrayObject m_spriteVao;
+    QVector<PointSpriteData> m_spriteData;
+    GLint m_spriteFirsts[(int)SpriteBatches::Count];
+    GLsizei m_spriteCounts[(int)SpriteBatches::Count];
+    QOpenGLBuffer *m_spriteBuffer;
+
+    GLMatrixStack m_matrixStack;
+
+    Cloud m_cloud;
+
+    QVector<Firework> m_fireworks;
+    ParticleBudget m_particleBudget;
+
+    SimulationModes m_simulationMode;
+    GpuParticleSystem m_gpuParticles[(int)FireworkTypes::Count];
+    AnalyticParticleSystem m_analyticParticles[(int)FireworkTypes::Count];
+    int m_simulationStep;
+    float m_gpuSimulationError;
+    bool m_gpuSimulationChecked;
+
+    RenderTarget *m_sceneTarget;
+    RenderTarget *m_cloudTarget;
+
+    ResolutionScaler m_resolutionScaler;
+
+    QString m_captureFileName;
+    CaptureFormats m_captureFormat;
+    FrameCapture m_frameCapture;
+};
+
+#endif // RENDERER_H
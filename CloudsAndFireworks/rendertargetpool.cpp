@@ -0,0 +1,147 @@
+#include "rendertargetpool.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QtDebug>
+
+RenderTargetPool::RenderTargetPool(GLStateCache &state, GpuMemoryTracker &memory)
+    : m_state(state)
+    , m_memory(memory)
+    , m_frame(0)
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    clear();
+}
+
+void RenderTargetPool::beginFrame()
+{
+    ++m_frame;
+
+    for(int i = 0; i < m_targets.size(); ++i) {
+        RenderTarget *target = m_targets.at(i);
+
+        if(!target->inUse && m_frame - target->lastUsedFrame > EVICT_DELAY) {
+            m_memory.unregisterAllocation(target);
+            delete target->framebuffer;
+            delete target;
+            m_targets.removeAt(i--);
+        }
+    }
+}
+
+RenderTarget *RenderTargetPool::acquire(const QSize &size, RenderTargetFormats format)
+{
+    RenderTarget *best = NULL;
+    RenderTarget *spare = NULL;
+
+    // The smallest free framebuffer that fits wins, a free one that is too small is reallocated instead of adding another
+    for(int i = 0; i < m_targets.size(); ++i) {
+        RenderTarget *target = m_targets.at(i);
+
+        if(target->inUse || target->format != format)
+            continue;
+
+        QSize allocated = target->framebuffer->size();
+
+        if(allocated.width() >= size.width() && allocated.height() >= size.height()) {
+            if(!best || area(allocated) < area(best->framebuffer->size()))
+                best = target;
+        } else if(!spare) {
+            spare = target;
+        }
+    }
+
+    if(best) {
+        // Shrinks only when much more than needed has been allocated for a while
+        if(area(best->framebuffer->size()) > 2 * area(allocationSize(size)))
+            ++best->oversizedFrames;
+        else
+            best->oversizedFrames = 0;
+
+        if(best->oversizedFrames > SHRINK_DELAY)
+            allocate(best, allocationSize(size));
+    } else {
+        best = spare;
+
+        if(!best) {
+            best = new RenderTarget();
+            best->format = format;
+            m_targets << best;
+        }
+
+        allocate(best, allocationSize(size));
+    }
+
+    best->size = size;
+    best->inUse = true;
+    best->lastUsedFrame = m_frame;
+
+    return best;
+}
+
+void RenderTargetPool::release(RenderTarget *target)
+{
+    if(target)
+        target->inUse = false;
+}
+
+void RenderTargetPool::clear()
+{
+    for(int i = 0; i < m_targets.size(); ++i) {
+        m_memory.unregisterAllocation(m_targets.at(i));
+        delete m_targets.at(i)->framebuffer;
+    }
+
+    qDeleteAll(m_targets);
+    m_targets.clear();
+}
+
+int RenderTargetPool::count() const
+{
+    return m_targets.size();
+}
+
+void RenderTargetPool::allocate(RenderTarget *target, const QSize &size)
+{
+    delete target->framebuffer;
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setInternalTextureFormat(GL_RGBA8);
+
+    if(target->format == RenderTargetFormats::Rgba8DepthStencil)
+        fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    target->framebuffer = new QOpenGLFramebufferObject(size, fboFormat);
+    target->oversizedFrames = 0;
+
+    // Layers rendered below the native resolution are stretched when they are composed
+    QOpenGLFunctions *functions = QOpenGLContext::currentContext()->functions();
+    functions->glBindTexture(GL_TEXTURE_2D, target->framebuffer->texture());
+    functions->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    functions->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // QOpenGLFramebufferObject binds its framebuffer and texture while it is created
+    m_state.invalidate();
+
+    bool depthStencil = target->format == RenderTargetFormats::Rgba8DepthStencil;
+    m_memory.registerAllocation(target, GpuMemoryCategories::Framebuffers, QStringLiteral("RenderTargetPool"),
+                                depthStencil ? QStringLiteral("RGBA8+D24S8") : QStringLiteral("RGBA8"),
+                                area(size) * (depthStencil ? 8 : 4));
+
+    qDebug() << QStringLiteral("RenderTargetPool: allocated") << size;
+}
+
+QSize RenderTargetPool::allocationSize(const QSize &size)
+{
+    int width = qMax(size.width(), 1);
+    int height = qMax(size.height(), 1);
+
+    return QSize((width + SIZE_STEP - 1) / SIZE_STEP * SIZE_STEP, (height + SIZE_STEP - 1) / SIZE_STEP * SIZE_STEP);
+}
+
+qint64 RenderTargetPool::area(const QSize &size)
+{
+    return qint64(size.width()) * size.height();
+}
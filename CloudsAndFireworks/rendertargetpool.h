@@ -0,0 +1,94 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <QOpenGLFramebufferObject>
+#include <QVector2D>
+#include <QVector>
+#include <QSize>
+#include "glstatecache.h"
+#include "gpumemorytracker.h"
+
+enum class RenderTargetFormats
+{
+    Rgba8,
+    Rgba8DepthStencil
+};
+
+struct RenderTarget
+{
+    QOpenGLFramebufferObject *framebuffer;
+    RenderTargetFormats format;
+    QSize size;
+    bool inUse;
+    quint64 lastUsedFrame;
+    int oversizedFrames;
+
+    RenderTarget()
+        : framebuffer(NULL)
+        , format(RenderTargetFormats::Rgba8)
+        , inUse(false)
+        , lastUsedFrame(0)
+        , oversizedFrames(0) {}
+
+    /*! Возвращает множитель текстурных координат, переводящий [0, 1] в занятую часть фреймбуффера. */
+    QVector2D texScale() const
+    {
+        return QVector2D((float)size.width() / framebuffer->width(), (float)size.height() / framebuffer->height());
+    }
+};
+
+/*!
+  @brief Класс пула фреймбуфферов.
+
+  Выдаёт фреймбуфферы по размеру и формату. Фреймбуффер, возвращённый в пул, достаётся следующему проходу,
+  поэтому проходы с непересекающимся временем жизни делят память. Фреймбуффер может быть больше запрошенного,
+  тогда рисуется только его левый нижний угол размера RenderTarget::size.
+  Размеры округляются вверх, а уменьшение происходит только после долгого простоя лишней площади,
+  поэтому изменение размера окна не пересоздаёт фреймбуфферы на каждом событии.
+  */
+
+
+class RenderTargetPool
+{
+
+public:
+    /*! Конструктор класса RenderTargetPool. */
+    RenderTargetPool(GLStateCache &state, GpuMemoryTracker &memory);
+
+    /*! Деструктор класса RenderTargetPool. Вызывать при текущем контексте! */
+    ~RenderTargetPool();
+
+    /*! Начинает новый кадр и удаляет фреймбуфферы, которые давно не запрашивались. */
+    void beginFrame();
+
+    /*!
+     * Выдаёт фреймбуффер формата <i>format</i>, вмещающий <i>size</i>. Создаёт или пересоздаёт его при необходимости.
+     * Содержимое не очищается. Фреймбуффер принадлежит вызывающему до release().
+     */
+    RenderTarget *acquire(const QSize &size, RenderTargetFormats format = RenderTargetFormats::Rgba8);
+
+    /*! Возвращает фреймбуффер <i>target</i> в пул. */
+    void release(RenderTarget *target);
+
+    /*! Удаляет все фреймбуфферы. Выданные фреймбуфферы становятся недействительными. */
+    void clear();
+
+    /*! Возвращает количество фреймбуфферов в пуле. */
+    int count() const;
+
+private:
+    void allocate(RenderTarget *target, const QSize &size);
+    static QSize allocationSize(const QSize &size);
+    static qint64 area(const QSize &size);
+
+    static const int SIZE_STEP = 64;
+    static const int SHRINK_DELAY = 120;
+    static const int EVICT_DELAY = 300;
+
+    GLStateCache &m_state;
+    GpuMemoryTracker &m_memory;
+    QVector<RenderTarget*> m_targets;
+    quint64 m_frame;
+};
+
+#endif // RENDERTARGETPOOL_H
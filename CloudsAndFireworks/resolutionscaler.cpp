@@ -0,0 +1,88 @@
+#include "resolutionscaler.h"
+#include <cmath>
+
+const float ResolutionScaler::SCALE_STEP = 0.05f;
+
+ResolutionScaler::ResolutionScaler()
+    : m_scale(1.0f)
+    , m_minScale(0.5f)
+    , m_maxScale(1.0f)
+    , m_targetMs(1000.0 / 60.0)
+    , m_smoothedMs(0.0)
+    , m_lastFrame(0)
+    , m_framesSinceAdjust(0)
+{
+}
+
+void ResolutionScaler::setBounds(float minScale, float maxScale)
+{
+    m_maxScale = qBound(SCALE_STEP, maxScale, 1.0f);
+    m_minScale = qBound(SCALE_STEP, minScale, m_maxScale);
+    m_scale = m_maxScale;
+}
+
+void ResolutionScaler::setTargetFrameRate(float framesPerSecond)
+{
+    if(framesPerSecond > 0.0f)
+        m_targetMs = 1000.0 / framesPerSecond;
+}
+
+void ResolutionScaler::update(const FrameTimings &timings)
+{
+    if(m_minScale == m_maxScale)
+        return;
+
+    // Timings arrive a few frames late, each finished frame is counted once
+    if(timings.frame == m_lastFrame || timings.gpuFrameMs <= 0.0)
+        return;
+
+    m_lastFrame = timings.frame;
+    m_smoothedMs = m_smoothedMs > 0.0 ? m_smoothedMs * 0.9 + timings.gpuFrameMs * 0.1 : timings.gpuFrameMs;
+
+    // Waiting between adjustments lets the results of the previous one reach the profiler
+    if(++m_framesSinceAdjust < ADJUST_INTERVAL)
+        return;
+
+    float scale = m_scale;
+
+    if(m_smoothedMs > m_targetMs * 0.95) {
+        // The cost of the scaled passes follows the pixel count, i.e. the square of the scale
+        scale = quantize(m_scale * std::sqrt(float(m_targetMs * 0.85 / m_smoothedMs)));
+        if(scale >= m_scale)
+            scale = quantize(m_scale - SCALE_STEP);
+    } else if(m_smoothedMs < m_targetMs * 0.7) {
+        scale = quantize(m_scale + SCALE_STEP);
+    }
+
+    scale = qBound(m_minScale, scale, m_maxScale);
+
+    if(scale != m_scale) {
+        m_scale = scale;
+        m_framesSinceAdjust = 0;
+    }
+}
+
+float ResolutionScaler::scale() const
+{
+    return m_scale;
+}
+
+float ResolutionScaler::minScale() const
+{
+    return m_minScale;
+}
+
+float ResolutionScaler::maxScale() const
+{
+    return m_maxScale;
+}
+
+double ResolutionScaler::smoothedGpuMs() const
+{
+    return m_smoothedMs;
+}
+
+float ResolutionScaler::quantize(float scale)
+{
+    return std::floor(scale / SCALE_STEP + 0.5f) * SCALE_STEP;
+}
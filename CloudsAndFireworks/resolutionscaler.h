@@ -0,0 +1,54 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include "frameprofiler.h"
+
+/*!
+  @brief Класс регулятора разрешения отрисовки.
+
+  По времени кадра на GPU подбирает масштаб внутреннего разрешения слоёв сцены в заданных пределах:
+  уменьшает его, когда кадр не укладывается в целевое время, и плавно возвращает, когда запас появляется снова.
+  */
+
+
+class ResolutionScaler
+{
+
+public:
+    /*! Конструктор класса ResolutionScaler. */
+    ResolutionScaler();
+
+    /*! Задаёт пределы масштаба <i>minScale</i> и <i>maxScale</i> из (0, 1]. Равные пределы отключают регулировку. */
+    void setBounds(float minScale, float maxScale);
+
+    /*! Задаёт целевую частоту кадров. */
+    void setTargetFrameRate(float framesPerSecond);
+
+    /*! Учитывает времена последнего готового кадра <i>timings</i> и при необходимости меняет масштаб. Вызывать раз в кадр. */
+    void update(const FrameTimings &timings);
+
+    /*! Возвращает текущий масштаб. */
+    float scale() const;
+
+    float minScale() const;
+    float maxScale() const;
+
+    /*! Возвращает сглаженное время кадра на GPU в миллисекундах. */
+    double smoothedGpuMs() const;
+
+private:
+    static float quantize(float scale);
+
+    static const int ADJUST_INTERVAL = 15;
+    static const float SCALE_STEP;
+
+    float m_scale;
+    float m_minScale;
+    float m_maxScale;
+    double m_targetMs;
+    double m_smoothedMs;
+    quint64 m_lastFrame;
+    int m_framesSinceAdjust;
+};
+
+#endif // RESOLUTIONSCALER_H
@@ -1,12 +1,27 @@
 #include "resourcemanager.h"
 #include <QtDebug>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cstring>
+#include <clocale>
+#include "tracer.h"
+
+const quint32 ResourceManager::PROGRAM_CACHE_MAGIC = 0x43465042;
 
 ResourceManager::ResourceManager()
     : m_defaultShaderProgram(NULL)
-    , m_activeShaderProgram(NULL)
-    , m_activeTexture(NULL)
+    , m_compressedTexturesSupported(false)
     , m_activeVertexBuffer(NULL)
-    , m_activeIndexBuffer(NULL)
+    , m_renderTargets(m_state, m_memory)
+    , m_extraFunctions(NULL)
+    , m_programBinarySupported(false)
 {
 }
 
@@ -14,7 +29,26 @@ bool ResourceManager::init()
 {
     bool success = true;
     success = initializeOpenGLFunctions();
+    success = success && m_state.init();
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    GLint binaryFormats = 0;
+
+    m_extraFunctions = context->extraFunctions();
+    m_driverString = QByteArray((const char *)glGetString(GL_VENDOR)) + '\0'
+                   + QByteArray((const char *)glGetString(GL_RENDERER)) + '\0'
+                   + QByteArray((const char *)glGetString(GL_VERSION));
+
+    if (context->format().version() >= qMakePair(4, 1) || context->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary")))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+
+    QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+    m_programCacheDir = cacheLocation + QStringLiteral("/shaders");
+    m_programBinarySupported = binaryFormats > 0 && !cacheLocation.isEmpty();
+
     m_defaultShaderProgram = createShaderProgram();
+    success = success && m_profiler.init();
     return success;
 }
 
@@ -28,6 +62,10 @@ ResourceManager::~ResourceManager()
     qDeleteAll(m_shaderHash);
     m_shaderHash.clear();
 
+    for(QHash<QString, QFuture<QImage> >::iterator it = m_pendingTextures.begin(); it != m_pendingTextures.end(); ++it)
+        it.value().waitForFinished();
+    m_pendingTextures.clear();
+
     qDeleteAll(m_textureHash);
     m_textureHash.clear();
 
@@ -39,21 +77,45 @@ ResourceManager::~ResourceManager()
 
 }
 
-QOpenGLShaderProgram *ResourceManager::createShaderProgram(QString fragmentShader, QString vertexShader, QString geometryShader)
+QOpenGLShaderProgram *ResourceManager::createShaderProgram(QString fragmentShader, QString vertexShader, QString geometryShader, QStringList defines,
+                                                          QStringList feedbackVaryings)
 {
-    if (m_shaderHash.contains(fragmentShader + vertexShader)) {
+    TRACE_SCOPE("ResourceManager::createShaderProgram");
+
+    QString programKey = fragmentShader + vertexShader + geometryShader + QLatin1Char('#') + defines.join(QLatin1Char(';'))
+                       + QLatin1Char('#') + feedbackVaryings.join(QLatin1Char(';'));
+
+    if (m_shaderHash.contains(programKey)) {
         qDebug() << QStringLiteral("Shader program already linked.");
-        return m_shaderHash.value(fragmentShader + vertexShader);
+        return m_shaderHash.value(programKey);
     }
 
+    QByteArray vertexSource = readShaderSource(vertexShader, defines);
+    QByteArray geometrySource = geometryShader != "" ? readShaderSource(geometryShader, defines) : QByteArray();
+    QByteArray fragmentSource = fragmentShader != "" ? readShaderSource(fragmentShader, defines) : QByteArray();
+
+    QByteArray cacheKey = programCacheKey(vertexSource + '\0' + geometrySource + '\0' + fragmentSource + '\0' + feedbackVaryings.join(QLatin1Char(';')).toLatin1());
+
     QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
-    m_shaderHash.insert(fragmentShader + vertexShader, program);
 
-    // Override system locale until shaders are compiled
+    if (loadProgramBinary(program, cacheKey)) {
+        qDebug() << QStringLiteral("Succesfully loaded shader program '") + fragmentShader + QStringLiteral("' from cache.");
+        m_shaderHash.insert(programKey, program);
+        return program;
+    }
+
+    // A program object that failed to load a binary cannot be reused
+    delete program;
+    program = new QOpenGLShaderProgram();
+    program->create();
+    m_shaderHash.insert(programKey, program);
+
+    // Override numeric locale until shaders are compiled
+    QByteArray previousLocale = setlocale(LC_NUMERIC, NULL);
     setlocale(LC_NUMERIC, "C");
 
     // Compile vertex shader
-    if (program->addShaderFromSourceFile(QOpenGLShader::Vertex, vertexShader)) {
+    if (program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource)) {
         qDebug() << QStringLiteral("Succesfully added vertex shader '") + vertexShader + QStringLiteral("'.");
     } else {
         QString error = QStringLiteral("Failed to add vertex shader '") + vertexShader + QStringLiteral("'!");
@@ -63,7 +125,7 @@ QOpenGLShaderProgram *ResourceManager::createShaderProgram(QString fragmentShade
     // Compile geometry shader
     if(geometryShader != "")
     {
-        if (program->addShaderFromSourceFile(QOpenGLShader::Geometry, geometryShader)) {
+        if (program->addShaderFromSourceCode(QOpenGLShader::Geometry, geometrySource)) {
             qDebug() << QStringLiteral("Succesfully added geometry shader '") + geometryShader + QStringLiteral("'.");
         } else {
             QString error = QStringLiteral("Failed to add geometry shader '") + geometryShader + QStringLiteral("'!");
@@ -72,13 +134,32 @@ QOpenGLShaderProgram *ResourceManager::createShaderProgram(QString fragmentShade
     }
 
     // Compile fragment shader
-    if (program->addShaderFromSourceFile(QOpenGLShader::Fragment, fragmentShader)) {
-        qDebug() << QStringLiteral("Succesfully added fragment shader '") + fragmentShader + QStringLiteral("'.");
-    } else {
-        QString error = QStringLiteral("Failed to add fragment shader '") + fragmentShader + QStringLiteral("'!");
-        qFatal(error.toLocal8Bit().data());
+    if(fragmentShader != "")
+    {
+        if (program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource)) {
+            qDebug() << QStringLiteral("Succesfully added fragment shader '") + fragmentShader + QStringLiteral("'.");
+        } else {
+            QString error = QStringLiteral("Failed to add fragment shader '") + fragmentShader + QStringLiteral("'!");
+            qFatal(error.toLocal8Bit().data());
+        }
     }
 
+    // Transform feedback outputs are part of the link state
+    if (!feedbackVaryings.isEmpty()) {
+        QList<QByteArray> names;
+        QVector<const char *> pointers;
+
+        for (int i = 0; i < feedbackVaryings.size(); ++i)
+            names << feedbackVaryings.at(i).toLatin1();
+        for (int i = 0; i < names.size(); ++i)
+            pointers << names.at(i).constData();
+
+        glTransformFeedbackVaryings(program->programId(), pointers.size(), pointers.constData(), GL_INTERLEAVED_ATTRIBS);
+    }
+
+    if (m_programBinarySupported)
+        m_extraFunctions->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     // Link shader pipeline
     if (program->link()) {
         qDebug() << QStringLiteral("Succesfully linked shader program.");
@@ -86,23 +167,128 @@ QOpenGLShaderProgram *ResourceManager::createShaderProgram(QString fragmentShade
         qFatal("Failed to link shader program!");
     }
 
-    // Restore system locale
-    setlocale(LC_ALL, "");
+    // Restore numeric locale
+    setlocale(LC_NUMERIC, previousLocale.constData());
+
+    saveProgramBinary(program, cacheKey);
 
     return program;
 }
 
-bool ResourceManager::bindShaderProgram(QOpenGLShaderProgram *shaderProgram)
+QByteArray ResourceManager::readShaderSource(const QString &fileName, const QStringList &defines)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        QString error = QStringLiteral("Failed to open shader '") + fileName + QStringLiteral("'!");
+        qFatal(error.toLocal8Bit().data());
+    }
+
+    QByteArray source = file.readAll();
+
+    if (defines.isEmpty())
+        return source;
+
+    QByteArray defineBlock;
+    for (int i = 0; i < defines.size(); ++i)
+        defineBlock += "#define " + defines.at(i).toLatin1() + '\n';
+
+    // #version must stay the first directive
+    int position = 0;
+    if (source.startsWith("#version")) {
+        position = source.indexOf('\n') + 1;
+        if (!position)
+            position = source.size();
+    }
+
+    return source.insert(position, defineBlock);
+}
+
+QByteArray ResourceManager::programCacheKey(const QByteArray &sources) const
 {
-    bool result = false;
-    if(shaderProgram != m_activeShaderProgram) {
-        result = shaderProgram->bind();
-        if(result)
-            m_activeShaderProgram = shaderProgram;
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_driverString);
+    hash.addData(sources);
+
+    return hash.result().toHex();
+}
+
+bool ResourceManager::loadProgramBinary(QOpenGLShaderProgram *program, const QByteArray &cacheKey)
+{
+    if (!m_programBinarySupported)
+        return false;
+
+    QFile file(m_programCacheDir + QLatin1Char('/') + QString::fromLatin1(cacheKey));
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, binaryFormat = 0;
+    QByteArray binary;
+
+    stream >> magic >> binaryFormat >> binary;
+    file.close();
+
+    if (stream.status() != QDataStream::Ok || magic != PROGRAM_CACHE_MAGIC || binary.isEmpty()) {
+        file.remove();
+        return false;
+    }
+
+    program->create();
+    m_extraFunctions->glProgramBinary(program->programId(), binaryFormat, binary.constData(), binary.size());
+
+    // A driver update may reject binaries even with the same version string, then the program is rebuilt
+    GLint linked = 0;
+    glGetProgramiv(program->programId(), GL_LINK_STATUS, &linked);
+
+    if (!linked || !program->link()) {
+        qDebug() << QStringLiteral("Cached shader program binary rejected by the driver.");
+        file.remove();
+        return false;
     }
-//    else qDebug() << QStringLiteral("Shader program already active.");
 
-    return result;
+    return true;
+}
+
+void ResourceManager::saveProgramBinary(QOpenGLShaderProgram *program, const QByteArray &cacheKey)
+{
+    if (!m_programBinarySupported)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0)
+        return;
+
+    QByteArray binary(length, Qt::Uninitialized);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+
+    m_extraFunctions->glGetProgramBinary(program->programId(), length, &written, &binaryFormat, binary.data());
+
+    if (written <= 0)
+        return;
+
+    binary.resize(written);
+
+    if (!QDir().mkpath(m_programCacheDir))
+        return;
+
+    QSaveFile file(m_programCacheDir + QLatin1Char('/') + QString::fromLatin1(cacheKey));
+
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << PROGRAM_CACHE_MAGIC << quint32(binaryFormat) << binary;
+    file.commit();
+}
+
+bool ResourceManager::bindShaderProgram(QOpenGLShaderProgram *shaderProgram)
+{
+    return m_state.useProgram(shaderProgram->programId());
 }
 
 void ResourceManager::bindDefaultShaderProgram()
@@ -110,10 +296,9 @@ void ResourceManager::bindDefaultShaderProgram()
     bindShaderProgram(m_defaultShaderProgram);
 }
 
-void ResourceManager::releaseShaderProgram(QOpenGLShaderProgram *shaderProgram)
+void ResourceManager::releaseShaderProgram(QOpenGLShaderProgram */*shaderProgram*/)
 {
-    shaderProgram->release();
-    m_activeShaderProgram = NULL;
+    m_state.useProgram(0);
 }
 
 void ResourceManager::releaseDefaultShaderProgram()
@@ -121,39 +306,173 @@ void ResourceManager::releaseDefaultShaderProgram()
     releaseShaderProgram(m_defaultShaderProgram);
 }
 
+bool ResourceManager::loadAssetPack(const QString &fileName)
+{
+    if(!QFile::exists(fileName)) {
+        qDebug() << QStringLiteral("No asset pack at '") + fileName + QStringLiteral("', textures are decoded from images.");
+        return false;
+    }
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    m_compressedTexturesSupported = context && context->hasExtension(QByteArrayLiteral("GL_EXT_texture_compression_s3tc"));
+
+    return m_assetPack.open(fileName);
+}
+
+const AssetPackEntry *ResourceManager::assetPackEntry(const QString &textureName) const
+{
+    const AssetPackEntry *entry = m_assetPack.entry(textureName);
+
+    // Compressed entries are skipped on drivers without S3TC, the image is decoded instead
+    if(entry && entry->format != (quint32)AssetFormats::Rgba8 && !m_compressedTexturesSupported)
+        return NULL;
+
+    return entry;
+}
+
+QOpenGLTexture *ResourceManager::createTextureFromPack(const AssetPackEntry *entry)
+{
+    QOpenGLTexture *texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+    texture->setSize(entry->width, entry->height);
+
+    if(entry->format == (quint32)AssetFormats::Rgba8) {
+        // Same storage and mipmaps as QOpenGLTexture(QImage) would create
+        texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+        texture->setMipLevels(texture->maximumMipLevels());
+        texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+        texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, m_assetPack.data(entry));
+        texture->generateMipMaps();
+    } else {
+        // Compressed levels are not generated on the GPU, so only the base level is used
+        texture->setFormat(entry->format == (quint32)AssetFormats::Bc1 ? QOpenGLTexture::RGB_DXT1 : QOpenGLTexture::RGBA_DXT5);
+        texture->setMipLevels(1);
+        texture->allocateStorage();
+        texture->setCompressedData(entry->size, m_assetPack.data(entry));
+        texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    }
+
+    return texture;
+}
+
 QOpenGLTexture *ResourceManager::createTexture(QString textureName)
 {
+    TRACE_SCOPE("ResourceManager::createTexture");
+
     if(m_textureHash.contains(textureName)) {
         qDebug() << QStringLiteral("Texture already linked.");
         return m_textureHash.value(textureName);
     }
 
-    QOpenGLTexture *texture = new QOpenGLTexture(QImage(textureName).mirrored());
+    const AssetPackEntry *entry = assetPackEntry(textureName);
+
+    if(entry) {
+        QOpenGLTexture *texture = createTextureFromPack(entry);
+        m_textureHash.insert(textureName, texture);
+        m_memory.registerTexture(texture, textureName);
+        return texture;
+    }
+
+    QImage image;
+
+    if(m_pendingTextures.contains(textureName)) {
+        // Usually already decoded by a worker thread while the GL thread was busy with other resources
+        image = m_pendingTextures.take(textureName).result();
+    } else {
+        image = decodeTexture(textureName);
+    }
+
+    QOpenGLTexture *texture = new QOpenGLTexture(image);
 
     m_textureHash.insert(textureName, texture);
+    m_memory.registerTexture(texture, textureName);
 
     return texture;
 }
 
-void ResourceManager::bindTexture(QOpenGLTexture *texture, GLenum textureUnit)
+void ResourceManager::preloadTextures(const QStringList &textureNames)
 {
-    if(texture != m_activeTexture) {
-        texture->bind(textureUnit - GL_TEXTURE0);
-        m_activeTexture = texture;
+    for(int i = 0; i < textureNames.size(); ++i) {
+        const QString &textureName = textureNames.at(i);
+
+        if(m_textureHash.contains(textureName) || m_pendingTextures.contains(textureName) || assetPackEntry(textureName))
+            continue;
+
+        m_pendingTextures.insert(textureName, QtConcurrent::run(&ResourceManager::decodeTexture, textureName));
+    }
+}
+
+void ResourceManager::uploadPreloadedTextures()
+{
+    TRACE_SCOPE("ResourceManager::uploadPreloadedTextures");
+
+    while(!m_pendingTextures.isEmpty()) {
+        QString textureName;
+
+        // Upload in the order the decodes finish, waiting only when none of them is ready yet
+        for(QHash<QString, QFuture<QImage> >::const_iterator it = m_pendingTextures.constBegin(); it != m_pendingTextures.constEnd(); ++it) {
+            if(it.value().isFinished()) {
+                textureName = it.key();
+                break;
+            }
+        }
+
+        if(textureName.isEmpty())
+            textureName = m_pendingTextures.constBegin().key();
+
+        createTexture(textureName);
+    }
+}
+
+QOpenGLTexture *ResourceManager::texture(const QString &textureName) const
+{
+    return m_textureHash.value(textureName, NULL);
+}
+
+QImage ResourceManager::decodeTexture(const QString &textureName)
+{
+    TRACE_SCOPE("ResourceManager::decodeTexture");
+
+    // Converted to the upload format here, so that QOpenGLTexture does not convert it on the GL thread
+    QImage image = QImage(textureName).convertToFormat(QImage::Format_RGBA8888);
+
+    // OpenGL expects the bottom row first. The rows are swapped in place instead of making a mirrored copy
+    int bytesPerLine = image.bytesPerLine();
+    QByteArray row(bytesPerLine, Qt::Uninitialized);
+
+    for(int top = 0, bottom = image.height() - 1; top < bottom; ++top, --bottom) {
+        uchar *topLine = image.scanLine(top);
+        uchar *bottomLine = image.scanLine(bottom);
+
+        memcpy(row.data(), topLine, bytesPerLine);
+        memcpy(topLine, bottomLine, bytesPerLine);
+        memcpy(bottomLine, row.constData(), bytesPerLine);
     }
-//    else qDebug() << QStringLiteral("Texture is already bound.");
+
+    return image;
+}
+
+void ResourceManager::bindTexture(QOpenGLTexture *texture, GLenum textureUnit)
+{
+    m_state.bindTexture(textureUnit, texture->textureId());
 }
 
-QOpenGLBuffer *ResourceManager::createVertexBuffer(int size, const void *data)
+void ResourceManager::bindTexture(GLuint textureID, GLenum textureUnit)
+{
+    m_state.bindTexture(textureUnit, textureID);
+}
+
+QOpenGLBuffer *ResourceManager::createVertexBuffer(int size, const void *data, QOpenGLBuffer::UsagePattern usage)
 {
     QOpenGLBuffer *vertexBuffer;
     vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
     vertexBuffer->create();
-    vertexBuffer->bind();
+    vertexBuffer->setUsagePattern(usage);
+    m_state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer->bufferId());
     vertexBuffer->allocate(data, size);
-    vertexBuffer->release();
 
     m_vertexBuffers.append(vertexBuffer);
+    m_vertexBufferSizes.insert(vertexBuffer, size);
+    m_memory.registerAllocation(vertexBuffer, GpuMemoryCategories::Buffers, QStringLiteral("ResourceManager"), QStringLiteral("Vertex"), size);
 
     return vertexBuffer;
 }
@@ -163,10 +482,47 @@ QOpenGLBuffer *ResourceManager::createVertexBuffer(QVector<VertexData> vertexDat
     return createVertexBuffer(vertexData.size() * sizeof(VertexData), vertexData.data());
 }
 
+void ResourceManager::streamVertexData(QOpenGLBuffer *vertexBuffer, const void *data, int size)
+{
+    int capacity = m_vertexBufferSizes.value(vertexBuffer);
+
+    if(size > capacity) {
+        capacity = qMax(size, capacity * 2);
+        m_vertexBufferSizes.insert(vertexBuffer, capacity);
+        m_memory.registerAllocation(vertexBuffer, GpuMemoryCategories::Buffers, QStringLiteral("ResourceManager"), QStringLiteral("Vertex"), capacity);
+    }
+
+    m_state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer->bufferId());
+    vertexBuffer->allocate(capacity);
+    vertexBuffer->write(0, data, size);
+}
+
+bool ResourceManager::writeVertexData(QOpenGLBuffer *vertexBuffer, int offset, const void *data, int size)
+{
+    if(offset + size > m_vertexBufferSizes.value(vertexBuffer))
+        return false;
+
+    m_state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer->bufferId());
+
+    // Unsynchronized, the caller guarantees that no pending draw reads the range
+    void *target = vertexBuffer->mapRange(offset, size, QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidate
+                                                      | QOpenGLBuffer::RangeUnsynchronized);
+    if(!target) {
+        vertexBuffer->write(offset, data, size);
+        return true;
+    }
+
+    memcpy(target, data, size);
+    vertexBuffer->unmap();
+    return true;
+}
+
 void ResourceManager::bindVertexBuffer(QOpenGLBuffer *vertexBuffer)
 {
+    m_state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer->bufferId());
+
+    // The attribute layout is stored in the VAO and only has to be set when the source buffer changes
     if(vertexBuffer != m_activeVertexBuffer) {
-        vertexBuffer->bind();
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (const void *)offsetof(VertexData, vertexCoords));
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (const void *)offsetof(VertexData, textureCoords));
         glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (const void *)offsetof(VertexData, color));
@@ -179,11 +535,13 @@ QOpenGLBuffer *ResourceManager::createIndexBuffer(int size, const void *data)
     QOpenGLBuffer *indexBuffer;
     indexBuffer = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
     indexBuffer->create();
-    indexBuffer->bind();
+    m_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->bufferId());
     indexBuffer->allocate(data, size);
-    indexBuffer->release();
+    // Index buffer bindings are VAO state, the buffer must not stay attached to whatever VAO is bound
+    m_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     m_indexBuffers.append(indexBuffer);
+    m_memory.registerAllocation(indexBuffer, GpuMemoryCategories::Buffers, QStringLiteral("ResourceManager"), QStringLiteral("Index"), size);
 
     return indexBuffer;
 }
@@ -195,30 +553,22 @@ QOpenGLBuffer *ResourceManager::createIndexBuffer(QVector<GLuint> indexData)
 
 void ResourceManager::bindIndexBuffer(QOpenGLBuffer *indexBuffer)
 {
-    if(indexBuffer != m_activeIndexBuffer) {
-        indexBuffer->bind();
-        m_activeIndexBuffer = indexBuffer;
-    }
+    m_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->bufferId());
 }
 
 void ResourceManager::releaseAllBuffers()
 {
-    if(m_activeVertexBuffer) {
-        m_activeVertexBuffer->release();
-        m_activeVertexBuffer = NULL;
-    }
-    if(m_activeIndexBuffer) {
-        m_activeIndexBuffer->release();
-        m_activeIndexBuffer = NULL;
-    }
+    m_state.bindBuffer(GL_ARRAY_BUFFER, 0);
+    m_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    m_activeVertexBuffer = NULL;
 }
 
 void ResourceManager::setupGLState()
 {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    m_state.setBlendEnabled(true);
+    m_state.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -227,11 +577,7 @@ void ResourceManager::setupGLState()
 
 void ResourceManager::restoreGLState()
 {
-    if(m_activeShaderProgram) {
-        m_activeShaderProgram->release();
-        m_activeShaderProgram = NULL;
-    }
-    m_activeTexture = NULL;
+    m_state.useProgram(0);
 
     releaseAllBuffers();
     glDisableVertexAttribArray(0);
@@ -239,7 +585,26 @@ void ResourceManager::restoreGLState()
     glDisableVertexAttribArray(2);
 
     glDepthMask(GL_FALSE);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDisable(GL_BLEND);
+    m_state.bindTexture(GL_TEXTURE0, 0);
+    m_state.setBlendEnabled(false);
+}
+
+FrameProfiler &ResourceManager::profiler()
+{
+    return m_profiler;
+}
+
+GLStateCache &ResourceManager::state()
+{
+    return m_state;
+}
+
+GpuMemoryTracker &ResourceManager::memory()
+{
+    return m_memory;
+}
+
+RenderTargetPool &ResourceManager::renderTargets()
+{
+    return m_renderTargets;
 }
@@ -7,7 +7,16 @@
 #include <QOpenGLTexture>
 #include <QHash>
 #include <QImage>
+#include <QFuture>
+#include <QStringList>
 #include <cstddef>
+#include "frameprofiler.h"
+#include "assetpack.h"
+#include "glstatecache.h"
+#include "gpumemorytracker.h"
+#include "rendertargetpool.h"
+
+class QOpenGLExtraFunctions;
 
 struct TextureBufferIDs
 {
@@ -47,12 +56,21 @@ struct VertexData
         , color(color) {}
 };
 
-enum class DefaultShaderModes
+struct PointSpriteData
 {
-    Solid,
-    Vertex,
-    Texture,
-    Tinted
+    QVector2D position;
+    QVector2D size;
+    GLfloat angle;
+    GLColor color;
+
+    PointSpriteData(QVector2D position = QVector2D(0.0f, 0.0f),
+                    QVector2D size = QVector2D(1.0f, 1.0f),
+                    GLfloat angle = 0.0f,
+                    GLColor color = GLColor(1.0f, 1.0f, 1.0f, 1.0f))
+        : position(position)
+        , size(size)
+        , angle(angle)
+        , color(color) {}
 };
 
 /*!
@@ -80,24 +98,51 @@ public:
 
     /*!
      * Создаёт шейдерную программу, принимая в качестве фрагментного шейдера - <i>fragmentShader</i>, а в качестве вершинного - <i>vertexShader</i>.
+     * Каждый элемент <i>defines</i> ("NAME" или "NAME VALUE") добавляется в исходники всех шейдеров как #define,
+     * для каждого набора определений создаётся и кэшируется отдельный вариант программы.
+     * Выходы <i>feedbackVaryings</i> записываются через transform feedback в один буффер, в этом случае
+     * <i>fragmentShader</i> может быть пустым.
      * Возвращает указатель на созданную шейдерную программу.
      */
-    QOpenGLShaderProgram *createShaderProgram(QString fragmentShader = ":/shaders/default.frag", QString vertexShader = ":/shaders/default.vert", QString geometryShader  = "");
+    QOpenGLShaderProgram *createShaderProgram(QString fragmentShader = ":/shaders/default.frag", QString vertexShader = ":/shaders/default.vert", QString geometryShader  = "", QStringList defines = QStringList(),
+                                              QStringList feedbackVaryings = QStringList());
+
+    /*!
+     * Открывает пакет ресурсов <i>fileName</i>. Текстуры из пакета загружаются вместо картинок с теми же именами.
+     * Вызывать при текущем контексте и до preloadTextures(). Возвращает <i>true</i>, если пакет открыт.
+     */
+    bool loadAssetPack(const QString &fileName);
 
     /*!
      * Создаёт текстуру, используя картинку <i>textureName</i>.
+     * Если текстура есть в пакете ресурсов, данные загружаются прямо из него, иначе декодируется картинка.
      * Возвращает указатель на созданную текстуру.
      */
     QOpenGLTexture *createTexture(QString textureName);
 
-    /*! Биндит текстуру <i>textureID</i>. */
+    /*!
+     * Запускает декодирование картинок <i>textureNames</i> в рабочих потоках.
+     * Текстуры создаются при вызове createTexture() или uploadPreloadedTextures().
+     */
+    void preloadTextures(const QStringList &textureNames);
+
+    /*! Создаёт текстуры из всех запрошенных картинок в порядке готовности. */
+    void uploadPreloadedTextures();
+
+    /*! Возвращает ранее созданную текстуру <i>textureName</i> или NULL. */
+    QOpenGLTexture *texture(const QString &textureName) const;
+
+    /*! Биндит текстуру <i>texture</i> к текстурному блоку <i>textureUnit</i>. */
     void bindTexture(QOpenGLTexture *texture, GLenum textureUnit = GL_TEXTURE0);
 
+    /*! Это перегруженная функция, биндит текстуру по её идентификатору <i>textureID</i>, например текстуру фреймбуффера. */
+    void bindTexture(GLuint textureID, GLenum textureUnit = GL_TEXTURE0);
+
     /*!
      * Создаёт вершинный буффер размера <i>size</i> и записывает туда данные <i>data</i>.
      * Возвращает указатель на созданный вершинный буффер.
      */
-    QOpenGLBuffer *createVertexBuffer(int size, const void *data = 0);
+    QOpenGLBuffer *createVertexBuffer(int size, const void *data = 0, QOpenGLBuffer::UsagePattern usage = QOpenGLBuffer::StaticDraw);
 
     /*!
      * Это перегруженная функция создания вершинного буффера. В качестве параметра принимает контейнер вершин <i>vertexData</i>.
@@ -105,6 +150,19 @@ public:
      */
     QOpenGLBuffer *createVertexBuffer(QVector<VertexData> vertexData);
 
+    /*!
+     * Заменяет содержимое вершинного буффера <i>vertexBuffer</i> данными <i>data</i> размера <i>size</i>.
+     * Старое хранилище отбрасывается, поэтому запись не ждёт отрисовок, ещё читающих его. Буффер растёт при необходимости.
+     */
+    void streamVertexData(QOpenGLBuffer *vertexBuffer, const void *data, int size);
+
+    /*!
+     * Записывает данные <i>data</i> размера <i>size</i> в вершинный буффер <i>vertexBuffer</i> со смещения <i>offset</i>,
+     * не дожидаясь отрисовок. Диапазон не должен читаться ещё не выполненными отрисовками!
+     * Возвращает false, если данные не помещаются в буффер, тогда буффер не меняется.
+     */
+    bool writeVertexData(QOpenGLBuffer *vertexBuffer, int offset, const void *data, int size);
+
     /*!
      * Создаёт индексный буффер размера <i>size</i> и записывает туда данные <i>data</i>.
      * Возвращает указатель на созданный индексный буффер.
@@ -120,7 +178,7 @@ public:
     /*! Возвращает указатель на шейдерную программу по умолчанию. */
     QOpenGLShaderProgram* defaultShaderProgram();
 
-    /*! Биндит шейдерную программу <i>shaderProgram</i>. */
+    /*! Биндит шейдерную программу <i>shaderProgram</i>. Возвращает <i>false</i>, если она уже была активна. */
     bool bindShaderProgram(QOpenGLShaderProgram *shaderProgram);
 
     /*! Биндит стандартную шейдерную программу. */
@@ -144,21 +202,54 @@ public:
     /*! Возвращает контекст в исходное состояние. */
     void restoreGLState();
 
+    /*! Возвращает профайлер кадра. */
+    FrameProfiler &profiler();
+
+    /*! Возвращает теневую копию состояния OpenGL. Через неё должны идти все смены состояния. */
+    GLStateCache &state();
+
+    /*! Возвращает учёт видеопамяти. В нём регистрируются все выделения на GPU, в том числе созданные вне менеджера. */
+    GpuMemoryTracker &memory();
+
+    /*! Возвращает пул фреймбуфферов. */
+    RenderTargetPool &renderTargets();
+
 private:
     void releaseAllBuffers();
+    static QImage decodeTexture(const QString &textureName);
+    const AssetPackEntry *assetPackEntry(const QString &textureName) const;
+    QOpenGLTexture *createTextureFromPack(const AssetPackEntry *entry);
+    QByteArray readShaderSource(const QString &fileName, const QStringList &defines);
+    QByteArray programCacheKey(const QByteArray &sources) const;
+    bool loadProgramBinary(QOpenGLShaderProgram *program, const QByteArray &cacheKey);
+    void saveProgramBinary(QOpenGLShaderProgram *program, const QByteArray &cacheKey);
+
+    static const quint32 PROGRAM_CACHE_MAGIC;
 
     QHash<QString, QOpenGLShaderProgram*> m_shaderHash;
     QOpenGLShaderProgram *m_defaultShaderProgram;
-    QOpenGLShaderProgram *m_activeShaderProgram;
 
     QHash<QString, QOpenGLTexture*> m_textureHash;
-    QOpenGLTexture *m_activeTexture;
+    QHash<QString, QFuture<QImage> > m_pendingTextures;
+
+    AssetPack m_assetPack;
+    bool m_compressedTexturesSupported;
 
     QVector<QOpenGLBuffer*> m_vertexBuffers;
+    QHash<QOpenGLBuffer*, int> m_vertexBufferSizes;
     QOpenGLBuffer *m_activeVertexBuffer;
 
     QVector<QOpenGLBuffer*> m_indexBuffers;
-    QOpenGLBuffer *m_activeIndexBuffer;
+
+    FrameProfiler m_profiler;
+    GLStateCache m_state;
+    GpuMemoryTracker m_memory;
+    RenderTargetPool m_renderTargets;
+
+    QOpenGLExtraFunctions *m_extraFunctions;
+    QByteArray m_driverString;
+    QString m_programCacheDir;
+    bool m_programBinarySupported;
 };
 
 #endif // RESOURCEMANAGER_H
@@ -6,12 +6,19 @@ layout(location = 1) in vec2 texcoord;
 layout(location = 2) in vec4 color;
 
 uniform mat4 modelViewProjectionMatrix;
+#ifdef SCALED_TEXCOORDS
+uniform vec2 texScale;
+#endif
 out vec2 v_texcoord;
 out vec4 v_color;
 
 void main(void)
 {
     gl_Position = modelViewProjectionMatrix * position;
+#ifdef SCALED_TEXCOORDS
+    v_texcoord = texcoord * texScale;
+#else
     v_texcoord = texcoord;
+#endif
     v_color = color;
 }
@@ -2,10 +2,24 @@
 #define EXPLOSION 0
 #define BLINKS 1
 #define SNAKES 2
+#define RIBBONS 3
+#ifndef MODE
+#error MODE must be defined as EXPLOSION, BLINKS, SNAKES or RIBBONS
+#endif
 uniform sampler2D tex;
-uniform int mode;
+#ifdef SPRITE_FLIPBOOK
+flat in vec2 v_spriteOffset;
+#define SPRITE_OFFSET v_spriteOffset
+#else
 uniform vec2 spriteOffset;
+#define SPRITE_OFFSET spriteOffset
+#endif
+#ifdef POINT_SPRITES
+#define PARTICLE_COLOR v_color
+#else
 uniform vec4 solidColor;
+#define PARTICLE_COLOR solidColor
+#endif
 in vec2 v_texcoord;
 in vec4 v_color;
 out vec4 fragColor;
@@ -13,16 +27,21 @@ out vec4 fragColor;
 void main(void)
 {
     vec4 surfaceColor;
-    if(mode == EXPLOSION) {
-        surfaceColor = texture(tex, (v_texcoord + spriteOffset) / 6.0) * v_color;
-    } else if(mode == BLINKS) {
-        surfaceColor = texture(tex, v_texcoord) * solidColor;
-        surfaceColor.rgb += (0.5 - abs(v_texcoord.s - 0.5)) * 0.5;
-        surfaceColor.rgb += (0.5 - abs(v_texcoord.t - 0.5)) * 0.5;
-    } else if(mode == SNAKES) {
-        surfaceColor = texture(tex, v_texcoord) * solidColor;
-        surfaceColor.rgb += (0.5 - abs(v_texcoord.s - 0.5)) * 4.0 * solidColor.a * (1.0 - surfaceColor.rgb);
-    }
+#if MODE == EXPLOSION
+    surfaceColor = texture(tex, (v_texcoord + SPRITE_OFFSET) / 6.0) * v_color;
+#elif MODE == BLINKS
+    surfaceColor = texture(tex, v_texcoord) * PARTICLE_COLOR;
+    surfaceColor.rgb += (0.5 - abs(v_texcoord.s - 0.5)) * 0.5;
+    surfaceColor.rgb += (0.5 - abs(v_texcoord.t - 0.5)) * 0.5;
+#elif MODE == SNAKES
+    surfaceColor = texture(tex, v_texcoord) * PARTICLE_COLOR;
+    surfaceColor.rgb += (0.5 - abs(v_texcoord.s - 0.5)) * 4.0 * PARTICLE_COLOR.a * (1.0 - surfaceColor.rgb);
+#elif MODE == RIBBONS
+    // s runs across the ribbon: a bright core that fades out towards both edges
+    float core = 1.0 - abs(v_texcoord.s - 0.5) * 2.0;
+    surfaceColor = vec4(v_color.rgb, v_color.a * core);
+    surfaceColor.rgb += core * 2.0 * v_color.a * (1.0 - surfaceColor.rgb);
+#endif
 
     surfaceColor.rgb *= surfaceColor.a;
     fragColor = surfaceColor;
@@ -0,0 +1,61 @@
+#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 size;
+layout(location = 2) in float angle;
+layout(location = 3) in vec4 color;
+layout(location = 4) in vec2 velocity;
+layout(location = 5) in float life;
+layout(location = 6) in float blink;
+layout(location = 7) in vec2 trajectoryOrigin;
+layout(location = 8) in vec2 trajectoryVelocity;
+layout(location = 9) in vec4 trajectoryColor;
+layout(location = 10) in vec4 trajectoryParams;
+layout(location = 11) in vec2 trajectorySeed;
+
+uniform uint frame;
+
+out vec2 s_position;
+out vec2 s_size;
+out float s_angle;
+out vec4 s_color;
+out vec2 s_velocity;
+out float s_life;
+out float s_blink;
+out vec2 s_trajectoryOrigin;
+out vec2 s_trajectoryVelocity;
+out vec4 s_trajectoryColor;
+out vec4 s_trajectoryParams;
+out vec2 s_trajectorySeed;
+
+void main(void)
+{
+    // Same step as Firework::moveParticle(), the new position uses the velocity of the previous frame
+    if(position.y + velocity.y >= LAUNCH_POSITION_Y)
+        s_position = position + velocity;
+    else
+        s_position = vec2(position.x + velocity.x, LAUNCH_POSITION_Y);
+
+    s_velocity = vec2(velocity.x * DAMPING, velocity.y * DAMPING - GRAVITY);
+
+    // Blinks flicker every fifth frame during the last 60 frames of their flight
+    s_color = color;
+    if(blink > 0.5 && life < 60.0 && mod(life, 5.0) < 0.5)
+        s_color.a = float(((uint(gl_VertexID) * 1664525u + frame * 1013904223u) >> 16u) & 1u);
+
+    // The sprite follows the velocity, atan() is undefined for a zero vector
+    if(blink > 0.5 || dot(s_velocity, s_velocity) == 0.0)
+        s_angle = 0.0;
+    else
+        s_angle = atan(-s_velocity.x, s_velocity.y);
+
+    // Snakes live maxTail frames longer than they fly, so the trail can fade out. The head is gone by then.
+    s_life = life - 1.0;
+    s_size = (s_life > trajectoryParams.z) ? size : vec2(0.0);
+    s_blink = blink;
+
+    s_trajectoryOrigin = trajectoryOrigin;
+    s_trajectoryVelocity = trajectoryVelocity;
+    s_trajectoryColor = trajectoryColor;
+    s_trajectoryParams = trajectoryParams;
+    s_trajectorySeed = trajectorySeed;
+}
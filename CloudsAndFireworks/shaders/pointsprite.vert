@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 size;
+layout(location = 2) in float angle;
+layout(location = 3) in vec4 color;
+
+out vec2 g_size;
+out float g_angle;
+out vec4 g_color;
+
+void main(void)
+{
+    // Stays in scene coordinates, the geometry shader transforms the corners
+    gl_Position = vec4(position, 0.0, 1.0);
+    g_size = size;
+    g_angle = angle;
+    g_color = color;
+}
@@ -0,0 +1,74 @@
+#version 330 core
+layout(location = 0) in vec2 origin;
+layout(location = 1) in vec2 velocity;
+layout(location = 2) in vec4 color;
+layout(location = 3) in vec4 params;
+layout(location = 4) in vec2 seed;
+
+uniform float time;
+
+out vec2 g_size;
+out float g_angle;
+out vec4 g_color;
+#ifdef SPRITE_FLIPBOOK
+out vec2 g_spriteOffset;
+#endif
+
+// Closed form of Firework::moveParticle() applied steps times
+vec2 trajectoryPosition(float steps, out vec2 currentVelocity)
+{
+    float decay = pow(DAMPING, steps);
+    float sum = (1.0 - decay) / (1.0 - DAMPING);
+    float fall = GRAVITY / (1.0 - DAMPING);
+
+    currentVelocity = decay * velocity - vec2(0.0, fall * (1.0 - decay));
+
+    // Once below the ground the vertical velocity stays negative, so the clamp never releases the particle
+    vec2 position = origin + velocity * sum - vec2(0.0, fall * (steps - sum));
+    position.y = max(position.y, LAUNCH_POSITION_Y);
+
+    return position;
+}
+
+void main(void)
+{
+    float age = time - params.x;
+#ifdef SPRITE_FLIPBOOK
+    // Same frames as Firework::calculateSpriteOffset(), the explosion lasts 64 frames
+    float frame = floor(age / 2.0);
+
+    gl_Position = vec4(origin, 0.0, 1.0);
+    g_size = (age >= 0.0 && age < 64.0) ? vec2(70.0) : vec2(0.0);
+    g_angle = 0.0;
+    g_color = vec4(1.0);
+    g_spriteOffset = vec2(mod(frame, 6.0), floor(frame / 6.0));
+#else
+    float flightDuration = params.y;
+    float maxTail = params.z;
+    float blink = seed.y;
+    float tail = float(gl_VertexID);
+
+    // Trail node k shows where the head was k frames ago
+    float steps = age - tail;
+    vec2 currentVelocity;
+
+    gl_Position = vec4(trajectoryPosition(max(steps, 0.0), currentVelocity), 0.0, 1.0);
+    g_color = color;
+
+    if(blink > 0.5) {
+        // Blinks get a random alpha at every fifth step of the last 60 frames of their flight
+        float remaining = ceil((flightDuration - age + 1.0) / 5.0) * 5.0;
+        if(remaining < 60.0) {
+            uint hash = uint(seed.x) * 1664525u + uint(params.x) * 22695477u + uint(remaining) * 1013904223u;
+            g_color.a = float((hash >> 16u) & 1u);
+        }
+        g_angle = 0.0;
+    } else {
+        g_color.a -= tail / max(maxTail, 1.0);
+        g_angle = dot(currentVelocity, currentVelocity) > 0.0 ? atan(-currentVelocity.x, currentVelocity.y) : 0.0;
+    }
+
+    bool visible = tail <= maxTail && steps >= 0.0 && steps < flightDuration && g_color.a > 0.0;
+    g_size = visible ? vec2(params.w) : vec2(0.0);
+#endif
+}
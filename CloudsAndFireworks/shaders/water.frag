@@ -1,6 +1,7 @@
 #version 330 core
 uniform sampler2D tex;
 uniform float angle;
+uniform vec2 texScale;
 in vec2 v_texcoord;
 in vec4 v_color;
 out vec4 fragColor;
@@ -11,7 +12,8 @@ void main(void)
     float wave_x = v_texcoord.x + wave * sin(radians(angle + v_texcoord.x * 360.0) + gl_FragCoord.x / 10.0);
     float wave_y = v_texcoord.y + wave * sin(radians(angle + v_texcoord.y * 360.0));
 
-    vec4 texColor = texture(tex, vec2(wave_x, wave_y)) * v_color;
+    // The layer may fill only a part of its framebuffer, the clamp keeps the waves from sampling outside it
+    vec4 texColor = texture(tex, clamp(vec2(wave_x, wave_y), 0.0, 1.0) * texScale) * v_color;
     texColor.rgb *= texColor.a;
 
     fragColor = texColor;
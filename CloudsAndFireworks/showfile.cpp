@@ -0,0 +1,80 @@
+#include "showfile.h"
+#include <QtDebug>
+
+ShowFile::ShowFile()
+    : m_mapping(NULL)
+    , m_size(0)
+{
+}
+
+ShowFile::~ShowFile()
+{
+    close();
+}
+
+bool ShowFile::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+
+    if(!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << QStringLiteral("ShowFile: failed to open '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_mapping = m_file.map(0, m_size);
+
+    if(!m_mapping || m_size < (qint64)sizeof(ShowFileHeader)) {
+        qWarning() << QStringLiteral("ShowFile: failed to map '") + fileName + QStringLiteral("'!");
+        close();
+        return false;
+    }
+
+    const ShowFileHeader *header = (const ShowFileHeader *)m_mapping;
+
+    // The cues themselves are checked while they are streamed, opening does not touch the whole timeline
+    if(header->magic != SHOW_FILE_MAGIC || header->version != SHOW_FILE_VERSION
+            || m_size < (qint64)(sizeof(ShowFileHeader) + quint64(header->cueCount) * sizeof(ShowCue))) {
+        qWarning() << QStringLiteral("ShowFile: '") + fileName + QStringLiteral("' is not a valid show file!");
+        close();
+        return false;
+    }
+
+    qDebug() << QStringLiteral("ShowFile: opened '") + fileName + QStringLiteral("' with") << header->cueCount
+             << QStringLiteral("cues in") << header->frames << QStringLiteral("frames.");
+
+    return true;
+}
+
+void ShowFile::close()
+{
+    if(m_mapping) {
+        m_file.unmap(m_mapping);
+        m_mapping = NULL;
+    }
+
+    m_file.close();
+    m_size = 0;
+}
+
+bool ShowFile::isOpen() const
+{
+    return m_mapping != NULL;
+}
+
+quint32 ShowFile::cueCount() const
+{
+    return m_mapping ? ((const ShowFileHeader *)m_mapping)->cueCount : 0;
+}
+
+quint32 ShowFile::frames() const
+{
+    return m_mapping ? ((const ShowFileHeader *)m_mapping)->frames : 0;
+}
+
+const ShowCue *ShowFile::cues() const
+{
+    return m_mapping ? (const ShowCue *)(m_mapping + sizeof(ShowFileHeader)) : NULL;
+}
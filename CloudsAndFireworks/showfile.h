@@ -0,0 +1,78 @@
+#ifndef SHOWFILE_H
+#define SHOWFILE_H
+
+#include <QFile>
+#include <QString>
+
+// "CFSH" in a little-endian file
+const quint32 SHOW_FILE_MAGIC = 0x48534643;
+const quint32 SHOW_FILE_VERSION = 1;
+
+struct ShowFileHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 cueCount;
+    quint32 frames;
+};
+
+/*!
+  Запуск в кадре <i>frame</i> от начала шоу. Точка задаётся долями ширины и высоты окна, <i>y</i> отсчитывается сверху.
+  Колец от 1 до FireworkParams::MAX_LEVEL, остальные запуски пропускаются. Нулевое зерно оставляет фейерверк на общем qrand().
+  */
+struct ShowCue
+{
+    quint32 frame;
+    float x;
+    float y;
+    quint32 seed;
+    quint8 type;
+    quint8 level;
+    quint8 color;
+    quint8 reserved;
+};
+
+/*!
+  @brief Класс файла шоу.
+
+  Файл содержит запуски, упорядоченные по кадрам, и отображается в память целиком:
+  запуски читаются прямо из отображения, без копирования всего сценария.
+  Файл собирается утилитой tools/showpacker.
+  */
+
+
+class ShowFile
+{
+
+public:
+    /*! Конструктор класса ShowFile. */
+    ShowFile();
+
+    /*! Деструктор класса ShowFile. */
+    ~ShowFile();
+
+    /*! Открывает и проверяет файл <i>fileName</i>. Возвращает <i>true</i> при успешном открытии. */
+    bool open(const QString &fileName);
+
+    /*! Закрывает файл. Запуски, полученные из файла, становятся недействительными. */
+    void close();
+
+    /*! Возвращает <i>true</i>, если файл открыт. */
+    bool isOpen() const;
+
+    /*! Возвращает количество запусков. */
+    quint32 cueCount() const;
+
+    /*! Возвращает длительность шоу в кадрах. */
+    quint32 frames() const;
+
+    /*! Возвращает указатель на запуски внутри отображения файла. */
+    const ShowCue *cues() const;
+
+private:
+    QFile m_file;
+    uchar *m_mapping;
+    qint64 m_size;
+};
+
+#endif // SHOWFILE_H
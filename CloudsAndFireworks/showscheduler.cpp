@@ -0,0 +1,129 @@
+#include "showscheduler.h"
+#include "renderer.h"
+#include <QtDebug>
+
+ShowScheduler::ShowScheduler()
+    : m_playing(false)
+    , m_finished(false)
+    , m_startFrame(0)
+    , m_frame(0)
+    , m_ringStart(0)
+    , m_ringCount(0)
+    , m_nextCue(0)
+    , m_lastCueFrame(0)
+    , m_launched(0)
+    , m_skipped(0)
+{
+}
+
+bool ShowScheduler::open(const QString &fileName)
+{
+    m_playing = false;
+    m_finished = false;
+
+    return m_file.open(fileName);
+}
+
+void ShowScheduler::start(uint renderedFrames)
+{
+    if(!m_file.isOpen())
+        return;
+
+    m_playing = true;
+    m_finished = false;
+    m_startFrame = renderedFrames;
+    m_frame = 0;
+
+    m_ringStart = 0;
+    m_ringCount = 0;
+    m_nextCue = 0;
+    m_lastCueFrame = 0;
+
+    m_launched = 0;
+    m_skipped = 0;
+}
+
+bool ShowScheduler::isPlaying() const
+{
+    return m_playing;
+}
+
+bool ShowScheduler::isFinished() const
+{
+    return m_finished;
+}
+
+void ShowScheduler::update(Renderer &renderer)
+{
+    if(!m_playing)
+        return;
+
+    m_frame = renderer.renderedFrames() - m_startFrame;
+
+    // More cues in one frame than the ring holds are streamed in several rounds
+    for(;;) {
+        fetch(m_frame + LOOKAHEAD_FRAMES);
+
+        if(!m_ringCount || m_ring[m_ringStart].frame > m_frame)
+            break;
+
+        const ShowCue &cue = m_ring[m_ringStart];
+
+        renderer.launchFirework(QPointF(cue.x * renderer.width(), cue.y * renderer.height()),
+                                FireworkParams((FireworkTypes)cue.type, cue.level, cue.color, cue.seed));
+
+        m_ringStart = (m_ringStart + 1) % RING_SIZE;
+        --m_ringCount;
+        ++m_launched;
+    }
+
+    if(!m_ringCount && m_nextCue == m_file.cueCount() && m_frame >= m_file.frames()) {
+        m_playing = false;
+        m_finished = true;
+
+        qDebug() << QStringLiteral("ShowScheduler: finished with") << m_launched << QStringLiteral("launches,")
+                 << m_skipped << QStringLiteral("cues skipped.");
+    }
+}
+
+void ShowScheduler::fetch(uint untilFrame)
+{
+    const ShowCue *cues = m_file.cues();
+
+    while(m_ringCount < RING_SIZE && m_nextCue < m_file.cueCount() && cues[m_nextCue].frame <= untilFrame) {
+        const ShowCue &cue = cues[m_nextCue++];
+
+        // A cue earlier than the previous one has missed its frame already, a cue with too many rings is not trusted
+        if(cue.frame < m_lastCueFrame || cue.type >= (quint8)FireworkTypes::Count || !cue.level || cue.level > FireworkParams::MAX_LEVEL) {
+            if(!m_skipped)
+                qWarning() << QStringLiteral("ShowScheduler: skipped cue") << m_nextCue - 1 << QStringLiteral("at frame") << cue.frame;
+
+            ++m_skipped;
+            continue;
+        }
+
+        m_lastCueFrame = cue.frame;
+        m_ring[(m_ringStart + m_ringCount) % RING_SIZE] = cue;
+        ++m_ringCount;
+    }
+}
+
+uint ShowScheduler::frame() const
+{
+    return m_frame;
+}
+
+uint ShowScheduler::frames() const
+{
+    return m_file.frames();
+}
+
+uint ShowScheduler::launched() const
+{
+    return m_launched;
+}
+
+uint ShowScheduler::skipped() const
+{
+    return m_skipped;
+}
@@ -0,0 +1,68 @@
+#ifndef SHOWSCHEDULER_H
+#define SHOWSCHEDULER_H
+
+#include "showfile.h"
+
+class Renderer;
+
+/*!
+  @brief Класс планировщика шоу.
+
+  Читает запуски из отображённого файла шоу на несколько кадров вперёд в кольцевой буффер фиксированного размера
+  и отдаёт их отрисовщику точно в кадре запуска. После открытия файла ничего не выделяет, сколько бы запусков ни было.
+  */
+
+
+class ShowScheduler
+{
+
+public:
+    /*! Конструктор класса ShowScheduler. */
+    ShowScheduler();
+
+    /*! Открывает файл шоу <i>fileName</i>. Возвращает <i>true</i> при успешном открытии. */
+    bool open(const QString &fileName);
+
+    /*! Начинает шоу: его нулевой кадр будет нарисован <i>renderedFrames</i>-м кадром отрисовщика. */
+    void start(uint renderedFrames);
+
+    bool isPlaying() const;
+    bool isFinished() const;
+
+    /*! Запускает фейерверки текущего кадра. Вызывать раз в кадр до render(). */
+    void update(Renderer &renderer);
+
+    /*! Возвращает номер текущего кадра шоу. */
+    uint frame() const;
+
+    /*! Возвращает длительность шоу в кадрах. */
+    uint frames() const;
+
+    uint launched() const;
+
+    /*! Возвращает количество пропущенных запусков: не по порядку кадров или с неверными параметрами. */
+    uint skipped() const;
+
+private:
+    void fetch(uint untilFrame);
+
+    static const uint LOOKAHEAD_FRAMES = 4;
+    static const int RING_SIZE = 1024;
+
+    ShowFile m_file;
+    bool m_playing;
+    bool m_finished;
+    uint m_startFrame;
+    uint m_frame;
+
+    ShowCue m_ring[RING_SIZE];
+    int m_ringStart;
+    int m_ringCount;
+    quint32 m_nextCue;
+    quint32 m_lastCueFrame;
+
+    uint m_launched;
+    uint m_skipped;
+};
+
+#endif // SHOWSCHEDULER_H
@@ -0,0 +1,179 @@
+#include "stresstest.h"
+#include "renderer.h"
+#include <QtDebug>
+#include <cmath>
+
+StressTest::StressTest()
+    : m_running(false)
+    , m_finished(false)
+    , m_launchRate(0.0f)
+    , m_pendingLaunches(0.0f)
+    , m_launched(0)
+    , m_stepFrame(0)
+    , m_stepFireworks(0)
+    , m_stepParticles(0)
+    , m_lastFrameMs(0.0)
+    , m_sustainedRate(0.0f)
+    , m_sustainedFireworks(0)
+    , m_sustainedParticles(0)
+{
+}
+
+void StressTest::start(const StressTestOptions &options)
+{
+    m_options = options;
+    m_running = true;
+    m_finished = false;
+
+    m_launchRate = options.launchRate;
+    m_pendingLaunches = 0.0f;
+    m_launched = 0;
+    m_stepFrame = 0;
+    m_stepFireworks = 0;
+    m_stepParticles = 0;
+    m_lastFrameMs = 0.0;
+
+    m_sustainedRate = 0.0f;
+    m_sustainedFireworks = 0;
+    m_sustainedParticles = 0;
+
+    qDebug() << QStringLiteral("StressTest: started at") << m_launchRate << QStringLiteral("launches/s with the")
+             << patternName(options.pattern) << QStringLiteral("pattern.");
+}
+
+bool StressTest::isRunning() const
+{
+    return m_running;
+}
+
+bool StressTest::isFinished() const
+{
+    return m_finished;
+}
+
+void StressTest::update(Renderer &renderer)
+{
+    if(!m_running)
+        return;
+
+    // Fractional launches carry over, so low rates still launch on average at the requested frequency
+    m_pendingLaunches += m_launchRate / FRAME_RATE;
+
+    for(; m_pendingLaunches >= 1.0f; m_pendingLaunches -= 1.0f) {
+        renderer.launchFirework(launchPosition(renderer.width(), renderer.height()));
+        ++m_launched;
+    }
+
+    m_stepFireworks = qMax(m_stepFireworks, renderer.fireworksCount());
+    m_stepParticles = qMax(m_stepParticles, renderer.particleBudget().live());
+
+    int stepFrames = qMax(1, qRound(m_options.stepSeconds * FRAME_RATE));
+
+    if(++m_stepFrame < stepFrames)
+        return;
+
+    // Either side can be the bottleneck, the frame only fits when both do
+    FrameTimings timings = renderer.resourceManager().profiler().average(stepFrames);
+    m_lastFrameMs = qMax(timings.cpuFrameMs, timings.gpuFrameMs);
+
+    if(m_lastFrameMs > m_options.frameTimeLimitMs || m_options.rampStep <= 0.0f) {
+        if(m_lastFrameMs <= m_options.frameTimeLimitMs) {
+            m_sustainedRate = m_launchRate;
+            m_sustainedFireworks = m_stepFireworks;
+            m_sustainedParticles = m_stepParticles;
+        }
+
+        m_running = false;
+        m_finished = true;
+
+        qDebug() << QStringLiteral("StressTest:") << report();
+        return;
+    }
+
+    m_sustainedRate = m_launchRate;
+    m_sustainedFireworks = m_stepFireworks;
+    m_sustainedParticles = m_stepParticles;
+
+    qDebug() << QStringLiteral("StressTest:") << m_launchRate << QStringLiteral("launches/s,") << m_stepFireworks
+             << QStringLiteral("fireworks,") << m_stepParticles << QStringLiteral("particles,") << m_lastFrameMs << QStringLiteral("ms per frame.");
+
+    m_launchRate += m_options.rampStep;
+    m_stepFrame = 0;
+    m_stepFireworks = 0;
+    m_stepParticles = 0;
+}
+
+float StressTest::launchRate() const
+{
+    return m_launchRate;
+}
+
+float StressTest::sustainedRate() const
+{
+    return m_sustainedRate;
+}
+
+int StressTest::sustainedFireworks() const
+{
+    return m_sustainedFireworks;
+}
+
+int StressTest::sustainedParticles() const
+{
+    return m_sustainedParticles;
+}
+
+QString StressTest::report() const
+{
+    if(!m_finished)
+        return QStringLiteral("limit of %1 ms not reached, %2 fireworks and %3 particles at %4 launches/s so far")
+                .arg(m_options.frameTimeLimitMs, 0, 'f', 1).arg(m_sustainedFireworks).arg(m_sustainedParticles).arg(m_sustainedRate, 0, 'f', 1);
+
+    if(m_lastFrameMs <= m_options.frameTimeLimitMs)
+        return QStringLiteral("%1 fireworks and %2 particles at %3 launches/s in %4 ms per frame, the ramp is disabled")
+                .arg(m_sustainedFireworks).arg(m_sustainedParticles).arg(m_sustainedRate, 0, 'f', 1).arg(m_lastFrameMs, 0, 'f', 2);
+
+    return QStringLiteral("sustained %1 fireworks and %2 particles at %3 launches/s, %4 launches/s took %5 ms per frame (limit %6 ms)")
+            .arg(m_sustainedFireworks).arg(m_sustainedParticles).arg(m_sustainedRate, 0, 'f', 1)
+            .arg(m_launchRate, 0, 'f', 1).arg(m_lastFrameMs, 0, 'f', 2).arg(m_options.frameTimeLimitMs, 0, 'f', 1);
+}
+
+QString StressTest::patternName(LaunchPatterns pattern)
+{
+    switch(pattern) {
+    case LaunchPatterns::Random:
+        return QStringLiteral("random");
+    case LaunchPatterns::Sweep:
+        return QStringLiteral("sweep");
+    case LaunchPatterns::Circle:
+        return QStringLiteral("circle");
+    case LaunchPatterns::Grid:
+        return QStringLiteral("grid");
+    default:
+        return QString();
+    }
+}
+
+QPointF StressTest::launchPosition(uint width, uint height)
+{
+    // Positions are in window coordinates, the fireworks explode in the upper part of the screen like the benchmark script
+    switch(m_options.pattern) {
+    case LaunchPatterns::Sweep: {
+        // Back and forth across the screen in 16 steps
+        int step = m_launched % 30;
+        float t = (step < 16 ? step : 30 - step) / 15.0f;
+        return QPointF(width * (0.05f + 0.9f * t), height * 0.25f);
+    }
+    case LaunchPatterns::Circle: {
+        float angle = m_launched * 2.0f * float(M_PI) / 12.0f;
+        float radius = qMin(width, height) * 0.15f;
+        return QPointF(width * 0.5f + radius * std::cos(angle), height * 0.27f + radius * std::sin(angle));
+    }
+    case LaunchPatterns::Grid: {
+        int column = m_launched % 8, row = (m_launched / 8) % 3;
+        return QPointF(width * (0.1f + 0.8f * column / 7.0f), height * (0.12f + 0.15f * row));
+    }
+    default:
+        return QPointF(qrand() % width, height * (0.1f + 0.35f * ((float)qrand() / (float)RAND_MAX)));
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef STRESSTEST_H
+#define STRESSTEST_H
+
+#include <QPointF>
+#include <QString>
+
+class Renderer;
+
+enum class LaunchPatterns
+{
+    Random,
+    Sweep,
+    Circle,
+    Grid,
+    Count
+};
+
+struct StressTestOptions
+{
+    float launchRate;
+    float rampStep;
+    float stepSeconds;
+    float frameTimeLimitMs;
+    LaunchPatterns pattern;
+
+    StressTestOptions()
+        : launchRate(1.0f)
+        , rampStep(1.0f)
+        , stepSeconds(4.0f)
+        , frameTimeLimitMs(1000.0f / 60.0f)
+        , pattern(LaunchPatterns::Random) {}
+};
+
+/*!
+  @brief Класс нагрузочного теста.
+
+  Запускает фейерверки с заданной частотой по выбранному шаблону и ступенчато её повышает, пока среднее
+  за ступень время кадра на CPU или GPU не превысит предел. Результат — наибольшее число одновременно летящих
+  фейерверков и живых частиц, которое сцена ещё выдерживает. Время идёт кадрами анимации, по 60 в секунду.
+  */
+
+
+class StressTest
+{
+
+public:
+    /*! Конструктор класса StressTest. */
+    StressTest();
+
+    /*! Начинает тест с параметрами <i>options</i>. */
+    void start(const StressTestOptions &options);
+
+    bool isRunning() const;
+    bool isFinished() const;
+
+    /*! Запускает фейерверки текущего кадра и в конце ступени проверяет время кадра. Вызывать раз в кадр до render(). */
+    void update(Renderer &renderer);
+
+    /*! Возвращает текущую частоту запусков в секунду. */
+    float launchRate() const;
+
+    /*! Возвращает наибольшую частоту запусков, при которой время кадра уложилось в предел. */
+    float sustainedRate() const;
+
+    /*! Возвращают пиковые количества фейерверков и частиц на ступени с частотой sustainedRate(). */
+    int sustainedFireworks() const;
+    int sustainedParticles() const;
+
+    /*! Возвращает итог теста одной строкой. */
+    QString report() const;
+
+    /*! Возвращает имя шаблона <i>pattern</i>, как оно задаётся в командной строке. */
+    static QString patternName(LaunchPatterns pattern);
+
+private:
+    QPointF launchPosition(uint width, uint height);
+
+    static const int FRAME_RATE = 60;
+
+    StressTestOptions m_options;
+    bool m_running;
+    bool m_finished;
+
+    float m_launchRate;
+    float m_pendingLaunches;
+    uint m_launched;
+    int m_stepFrame;
+
+    int m_stepFireworks;
+    int m_stepParticles;
+    double m_lastFrameMs;
+
+    float m_sustainedRate;
+    int m_sustainedFireworks;
+    int m_sustainedParticles;
+};
+
+#endif // STRESSTEST_H
@@ -0,0 +1,18 @@
+QT       += core gui
+QT       -= widgets
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = assetpacker
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../assetpack.cpp
+
+HEADERS  += \
+    ../../assetpack.h
+
+QMAKE_CXXFLAGS += -std=c++11
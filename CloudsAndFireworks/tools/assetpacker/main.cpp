@@ -0,0 +1,289 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QImage>
+#include <QFile>
+#include <QDir>
+#include <QVector>
+#include <QtDebug>
+#include <cstring>
+#include <climits>
+#include "assetpack.h"
+
+/*
+ * Packs images into an asset pack for CloudsAndFireworks.
+ *
+ * Usage: assetpacker [--bc] <output.pak> <resource dir> <image>...
+ *
+ * Images are given relative to the resource dir and are stored under their qrc names (":/images/x.png"),
+ * converted to RGBA8 and flipped bottom row first. With --bc opaque images are stored as BC1 and images
+ * with alpha as BC3. The encoder only fits the bounding box of each block, it is meant for the small
+ * particle textures and the background, not for general use.
+ */
+
+namespace {
+
+quint16 packColor(const uchar *color)
+{
+    return quint16(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+}
+
+void unpackColor(quint16 packed, int *color)
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+void writeLittleEndian(uchar *out, quint64 value, int bytes)
+{
+    for(int i = 0; i < bytes; ++i)
+        out[i] = uchar(value >> (8 * i));
+}
+
+// 16 RGBA pixels in, 8 bytes out
+void encodeColorBlock(const uchar block[16][4], uchar *out)
+{
+    uchar minColor[3] = {255, 255, 255}, maxColor[3] = {0, 0, 0};
+
+    for(int i = 0; i < 16; ++i) {
+        for(int c = 0; c < 3; ++c) {
+            minColor[c] = qMin(minColor[c], block[i][c]);
+            maxColor[c] = qMax(maxColor[c], block[i][c]);
+        }
+    }
+
+    // Insetting the box a little moves the endpoints off the outliers and lowers the average error
+    for(int c = 0; c < 3; ++c) {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    quint16 color0 = packColor(maxColor), color1 = packColor(minColor);
+    quint32 indices = 0;
+
+    if(color0 < color1)
+        qSwap(color0, color1);
+
+    // color0 > color1 selects the four color mode, equal endpoints need no indices at all
+    if(color0 != color1) {
+        int palette[4][3];
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+
+        for(int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for(int i = 0; i < 16; ++i) {
+            int best = 0, bestError = INT_MAX;
+
+            for(int p = 0; p < 4; ++p) {
+                int error = 0;
+                for(int c = 0; c < 3; ++c)
+                    error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+
+                if(error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+
+            indices |= quint32(best) << (2 * i);
+        }
+    }
+
+    writeLittleEndian(out, color0, 2);
+    writeLittleEndian(out + 2, color1, 2);
+    writeLittleEndian(out + 4, indices, 4);
+}
+
+// 16 RGBA pixels in, 8 bytes of BC3 alpha out
+void encodeAlphaBlock(const uchar block[16][4], uchar *out)
+{
+    int alpha0 = 0, alpha1 = 255;
+
+    for(int i = 0; i < 16; ++i) {
+        alpha0 = qMax(alpha0, int(block[i][3]));
+        alpha1 = qMin(alpha1, int(block[i][3]));
+    }
+
+    quint64 indices = 0;
+
+    // alpha0 > alpha1 selects the eight value mode
+    if(alpha0 != alpha1) {
+        int palette[8] = {alpha0, alpha1};
+        for(int p = 1; p < 7; ++p)
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+        for(int i = 0; i < 16; ++i) {
+            int best = 0, bestError = INT_MAX;
+
+            for(int p = 0; p < 8; ++p) {
+                int error = qAbs(block[i][3] - palette[p]);
+
+                if(error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+
+            indices |= quint64(best) << (3 * i);
+        }
+    }
+
+    out[0] = uchar(alpha0);
+    out[1] = uchar(alpha1);
+    writeLittleEndian(out + 2, indices, 6);
+}
+
+QByteArray encodeBc(const QImage &image, AssetFormats format)
+{
+    int width = image.width(), height = image.height();
+    int blockBytes = format == AssetFormats::Bc1 ? 8 : 16;
+    QByteArray result(int(AssetPack::dataSize(format, width, height)), Qt::Uninitialized);
+    uchar *out = (uchar *)result.data();
+    uchar block[16][4];
+
+    for(int by = 0; by < (height + 3) / 4; ++by) {
+        for(int bx = 0; bx < (width + 3) / 4; ++bx) {
+            // Partial blocks at the edges repeat the last row and column
+            for(int y = 0; y < 4; ++y) {
+                const uchar *line = image.constScanLine(qMin(by * 4 + y, height - 1));
+                for(int x = 0; x < 4; ++x)
+                    memcpy(block[y * 4 + x], line + 4 * qMin(bx * 4 + x, width - 1), 4);
+            }
+
+            if(format == AssetFormats::Bc3) {
+                encodeAlphaBlock(block, out);
+                encodeColorBlock(block, out + 8);
+            } else {
+                encodeColorBlock(block, out);
+            }
+
+            out += blockBytes;
+        }
+    }
+
+    return result;
+}
+
+bool isOpaque(const QImage &image)
+{
+    for(int y = 0; y < image.height(); ++y) {
+        const uchar *line = image.constScanLine(y);
+        for(int x = 0; x < image.width(); ++x) {
+            if(line[4 * x + 3] != 255)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    arguments.removeFirst();
+
+    bool compress = arguments.removeAll(QStringLiteral("--bc")) > 0;
+
+    if(arguments.size() < 3) {
+        qWarning("Usage: assetpacker [--bc] <output.pak> <resource dir> <image>...");
+        return 1;
+    }
+
+    QString outputName = arguments.takeFirst();
+    QDir resourceDir(arguments.takeFirst());
+
+    QVector<AssetPackEntry> entries;
+    QVector<QByteArray> payloads;
+
+    for(int i = 0; i < arguments.size(); ++i) {
+        QString name = QDir::cleanPath(arguments.at(i));
+        QImage image(resourceDir.filePath(name));
+
+        if(image.isNull()) {
+            qWarning() << "Failed to load" << resourceDir.filePath(name);
+            return 1;
+        }
+
+        // Same layout as ResourceManager::decodeTexture produces at runtime
+        image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+        QByteArray qrcName = (QStringLiteral(":/") + name).toUtf8();
+
+        if(qrcName.size() >= (int)sizeof(AssetPackEntry().name)) {
+            qWarning() << "Resource name is too long:" << qrcName;
+            return 1;
+        }
+
+        AssetPackEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, qrcName.constData(), qrcName.size());
+        entry.width = image.width();
+        entry.height = image.height();
+
+        QByteArray payload;
+
+        if(compress) {
+            AssetFormats format = isOpaque(image) ? AssetFormats::Bc1 : AssetFormats::Bc3;
+            entry.format = (quint32)format;
+            payload = encodeBc(image, format);
+        } else {
+            entry.format = (quint32)AssetFormats::Rgba8;
+            for(int y = 0; y < image.height(); ++y)
+                payload.append((const char *)image.constScanLine(y), image.width() * 4);
+        }
+
+        entry.size = payload.size();
+
+        entries << entry;
+        payloads << payload;
+
+        qDebug() << qrcName.constData() << entry.width << "x" << entry.height << "format" << entry.format << entry.size << "bytes";
+    }
+
+    // Payloads start at aligned offsets after the header and the entry table
+    quint64 offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+
+    for(int i = 0; i < entries.size(); ++i) {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        entries[i].offset = offset;
+        offset += entries.at(i).size;
+    }
+
+    QFile file(outputName);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open" << outputName;
+        return 1;
+    }
+
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = entries.size();
+
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)entries.constData(), entries.size() * sizeof(AssetPackEntry));
+
+    for(int i = 0; i < entries.size(); ++i) {
+        file.write(QByteArray(int(entries.at(i).offset - file.pos()), '\0'));
+        file.write(payloads.at(i));
+    }
+
+    file.close();
+
+    qDebug() << "Wrote" << entries.size() << "assets to" << outputName;
+
+    return 0;
+}
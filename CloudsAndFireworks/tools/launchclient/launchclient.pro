@@ -0,0 +1,15 @@
+QT       += core network
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = launchclient
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+# Only the message layout is taken from launchserver.h, the header is not moc'ed here
+SOURCES += main.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,129 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <QtDebug>
+#include <cstring>
+#include "launchserver.h"
+
+/*
+ * Sends launch commands to CloudsAndFireworks started with --listen, in place of the venue controller.
+ *
+ * Usage: launchclient [--server CloudsAndFireworks] [--rate 10000] [--batch 100] [--seconds 10] [--random]
+ *
+ * Commands go out in batches of --batch launches at --rate launches per second over the whole screen,
+ * as seeded cues or, with --random, as plain launches like mouse clicks. Writes block while the application
+ * does not keep up, so the reported rate is the rate it actually accepted.
+ */
+
+namespace {
+
+QString argumentValue(QStringList &arguments, const QString &name, const QString &defaultValue)
+{
+    int index = arguments.indexOf(name);
+
+    if(index < 0 || index + 1 >= arguments.size())
+        return defaultValue;
+
+    QString value = arguments.at(index + 1);
+    arguments.erase(arguments.begin() + index, arguments.begin() + index + 2);
+
+    return value;
+}
+
+void fillBatch(QByteArray &message, int count, bool random, quint32 &sequence)
+{
+    quint32 header[2] = { quint32(sizeof(quint32) + count * sizeof(LaunchCommand)), quint32(count) };
+
+    message.resize(sizeof(header) + count * sizeof(LaunchCommand));
+    memcpy(message.data(), header, sizeof(header));
+
+    LaunchCommand *commands = (LaunchCommand *)(message.data() + sizeof(header));
+
+    for(int i = 0; i < count; ++i, ++sequence) {
+        LaunchCommand &command = commands[i];
+
+        memset(&command, 0, sizeof(command));
+        command.x = 0.05f + 0.9f * ((float)qrand() / (float)RAND_MAX);
+        command.y = 0.1f + 0.35f * ((float)qrand() / (float)RAND_MAX);
+
+        if(!random) {
+            command.type = sequence % 3 ? 1 : 0;
+            command.level = 4 + sequence % 4;
+            command.color = sequence % 12;
+            command.seed = sequence + 1;
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    arguments.removeFirst();
+
+    bool random = arguments.removeAll(QStringLiteral("--random")) > 0;
+    QString server = argumentValue(arguments, QStringLiteral("--server"), QStringLiteral("CloudsAndFireworks"));
+    double rate = argumentValue(arguments, QStringLiteral("--rate"), QStringLiteral("10000")).toDouble();
+    int batch = argumentValue(arguments, QStringLiteral("--batch"), QStringLiteral("100")).toInt();
+    double seconds = argumentValue(arguments, QStringLiteral("--seconds"), QStringLiteral("10")).toDouble();
+
+    if(!arguments.isEmpty() || rate <= 0.0 || batch <= 0 || batch > (int)LaunchListener::MAX_BATCH || seconds <= 0.0) {
+        qWarning("Usage: launchclient [--server CloudsAndFireworks] [--rate 10000] [--batch 100] [--seconds 10] [--random]");
+        return 1;
+    }
+
+    QLocalSocket socket;
+    socket.connectToServer(server);
+
+    if(!socket.waitForConnected(3000)) {
+        qWarning() << "Failed to connect to" << server << ":" << socket.errorString();
+        return 1;
+    }
+
+    QByteArray message;
+    quint32 sequence = 0;
+    qint64 sent = 0, sentThisSecond = 0;
+    QElapsedTimer timer, secondTimer;
+
+    timer.start();
+    secondTimer.start();
+
+    while(timer.elapsed() < seconds * 1000.0) {
+        // Batches due by now go out at once, the loop sleeps only when it is ahead of the schedule
+        qint64 due = qint64(timer.nsecsElapsed() / 1000000000.0 * rate);
+
+        if(sent + batch > due) {
+            QThread::usleep(500);
+            continue;
+        }
+
+        fillBatch(message, batch, random, sequence);
+        socket.write(message);
+
+        if(!socket.waitForBytesWritten(5000)) {
+            qWarning() << "Failed to send:" << socket.errorString();
+            return 1;
+        }
+
+        sent += batch;
+        sentThisSecond += batch;
+
+        if(secondTimer.elapsed() >= 1000) {
+            qDebug() << sentThisSecond * 1000.0 / secondTimer.elapsed() << "launches/s";
+            sentThisSecond = 0;
+            secondTimer.restart();
+        }
+    }
+
+    socket.disconnectFromServer();
+
+    qDebug() << "Sent" << sent << "launches in" << timer.elapsed() / 1000.0 << "s," << sent * 1000.0 / qMax(timer.elapsed(), qint64(1)) << "launches/s";
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+#include "showfile.h"
+
+/*
+ * Packs a show script into a show file for CloudsAndFireworks.
+ *
+ * Usage: showpacker <output.show> <script.csv>
+ *        showpacker --generate <cues> <frames> <seed> <output.show>
+ *
+ * Every script line is a cue "frame,x,y,type,level,color,seed": x and y are fractions of the window
+ * width and height measured from the top left corner, type is "blinks" or "snakes", level is 1 to 7 rings, color is an index into
+ * the firework palette (11 and above are white) and a seed of 0 leaves the firework to qrand().
+ * Empty lines and lines starting with '#' are skipped. Cues are sorted by frame, cues of the same frame
+ * keep their order. --generate writes a random show for load tests.
+ */
+
+namespace {
+
+const quint8 TYPE_BLINKS = 0;
+const quint8 TYPE_SNAKES = 1;
+const quint8 MAX_LEVEL = 7;
+
+bool parseCue(const QString &line, ShowCue &cue)
+{
+    QStringList fields = line.split(',');
+
+    if(fields.size() != 7)
+        return false;
+
+    bool ok[6];
+    QString type = fields.at(3).trimmed();
+
+    memset(&cue, 0, sizeof(cue));
+    cue.frame = fields.at(0).trimmed().toUInt(&ok[0]);
+    cue.x = fields.at(1).trimmed().toFloat(&ok[1]);
+    cue.y = fields.at(2).trimmed().toFloat(&ok[2]);
+    cue.level = (quint8)qMin(fields.at(4).trimmed().toUInt(&ok[3]), 255u);
+    cue.color = (quint8)qMin(fields.at(5).trimmed().toUInt(&ok[4]), 255u);
+    cue.seed = fields.at(6).trimmed().toUInt(&ok[5]);
+
+    if(type == QStringLiteral("blinks"))
+        cue.type = TYPE_BLINKS;
+    else if(type == QStringLiteral("snakes"))
+        cue.type = TYPE_SNAKES;
+    else
+        return false;
+
+    return ok[0] && ok[1] && ok[2] && ok[3] && ok[4] && ok[5] && cue.level && cue.level <= MAX_LEVEL;
+}
+
+QVector<ShowCue> generateCues(quint32 count, quint32 frames, quint32 seed)
+{
+    QVector<ShowCue> cues(count);
+
+    qsrand(seed);
+
+    for(quint32 i = 0; i < count; ++i) {
+        ShowCue &cue = cues[i];
+
+        memset(&cue, 0, sizeof(cue));
+        cue.frame = frames ? quint32(qrand()) % frames : 0;
+        cue.x = 0.05f + 0.9f * ((float)qrand() / (float)RAND_MAX);
+        cue.y = 0.1f + 0.35f * ((float)qrand() / (float)RAND_MAX);
+        cue.type = qrand() % 3 ? TYPE_SNAKES : TYPE_BLINKS;
+        cue.level = 4 + qrand() % 4;
+        cue.color = qrand() % 12;
+        cue.seed = 1 + quint32(qrand());
+    }
+
+    return cues;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    arguments.removeFirst();
+
+    QVector<ShowCue> cues;
+    QString outputName;
+
+    if(arguments.size() == 5 && arguments.at(0) == QStringLiteral("--generate")) {
+        cues = generateCues(arguments.at(1).toUInt(), arguments.at(2).toUInt(), arguments.at(3).toUInt());
+        outputName = arguments.at(4);
+    } else if(arguments.size() == 2) {
+        outputName = arguments.at(0);
+
+        QFile script(arguments.at(1));
+
+        if(!script.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Failed to open" << arguments.at(1);
+            return 1;
+        }
+
+        QTextStream stream(&script);
+        int lineNumber = 0;
+        ShowCue cue;
+
+        while(!stream.atEnd()) {
+            QString line = stream.readLine().trimmed();
+            ++lineNumber;
+
+            if(line.isEmpty() || line.startsWith('#'))
+                continue;
+
+            if(!parseCue(line, cue)) {
+                qWarning() << "Invalid cue in line" << lineNumber << ":" << line;
+                return 1;
+            }
+
+            cues << cue;
+        }
+    } else {
+        qWarning("Usage: showpacker <output.show> <script.csv>\n"
+                 "       showpacker --generate <cues> <frames> <seed> <output.show>");
+        return 1;
+    }
+
+    // The scheduler streams cues in file order and drops the ones that go back in time
+    std::stable_sort(cues.begin(), cues.end(), [](const ShowCue &a, const ShowCue &b) { return a.frame < b.frame; });
+
+    QFile file(outputName);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open" << outputName;
+        return 1;
+    }
+
+    ShowFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SHOW_FILE_MAGIC;
+    header.version = SHOW_FILE_VERSION;
+    header.cueCount = cues.size();
+    header.frames = cues.isEmpty() ? 0 : cues.last().frame + 1;
+
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)cues.constData(), cues.size() * sizeof(ShowCue));
+
+    file.close();
+
+    qDebug() << "Wrote" << cues.size() << "cues in" << header.frames << "frames to" << outputName;
+
+    return 0;
+}
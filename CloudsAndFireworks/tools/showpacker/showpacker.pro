@@ -0,0 +1,17 @@
+QT       += core
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = showpacker
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp
+
+HEADERS  += \
+    ../../showfile.h
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,125 @@
+#include "tracer.h"
+
+#ifdef ENABLE_TRACING
+
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtDebug>
+
+namespace {
+
+// Thread names are set by the application, they may contain characters that would break the JSON string
+QString jsonEscaped(QString text)
+{
+    text.replace(QLatin1Char('\\'), QStringLiteral("\\\\"));
+    text.replace(QLatin1Char('"'), QStringLiteral("\\\""));
+
+    return text;
+}
+
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer()
+{
+    m_timer.start();
+}
+
+Tracer::~Tracer()
+{
+    qDeleteAll(m_buffers);
+    m_buffers.clear();
+}
+
+qint64 Tracer::now() const
+{
+    return m_timer.nsecsElapsed();
+}
+
+TraceBuffer *Tracer::threadBuffer()
+{
+    static thread_local TraceBuffer *buffer = NULL;
+
+    if(!buffer) {
+        QMutexLocker locker(&m_mutex);
+
+        QString threadName = QThread::currentThread()->objectName();
+        if(threadName.isEmpty())
+            threadName = QStringLiteral("Thread %1").arg(m_buffers.size());
+
+        buffer = new TraceBuffer(m_buffers.size(), threadName);
+        m_buffers << buffer;
+    }
+
+    return buffer;
+}
+
+void Tracer::record(const char *name, qint64 start, qint64 duration)
+{
+    TraceBuffer *buffer = threadBuffer();
+    quint64 index = buffer->written.load(std::memory_order_relaxed);
+
+    TraceEvent &event = buffer->events[index % TraceBuffer::CAPACITY];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::flush(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        qWarning() << QStringLiteral("Tracer: failed to open '") + fileName + QStringLiteral("'!");
+        return false;
+    }
+
+    QTextStream stream(&file);
+    stream.setRealNumberNotation(QTextStream::FixedNotation);
+    stream.setRealNumberPrecision(3);
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    quint64 count = 0;
+
+    for(int i = 0; i < m_buffers.size(); ++i) {
+        TraceBuffer *buffer = m_buffers.at(i);
+
+        stream << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+               << ",\"args\":{\"name\":\"" << jsonEscaped(buffer->threadName) << "\"}}";
+        first = false;
+
+        // Every flush writes the whole retained ring, so an earlier flush to another file loses nothing here.
+        // Events of other threads may be overwritten while they are read if their buffer wraps meanwhile.
+        quint64 written = buffer->written.load(std::memory_order_acquire);
+        quint64 begin = written > TraceBuffer::CAPACITY ? written - TraceBuffer::CAPACITY : 0;
+
+        for(quint64 j = begin; j < written; ++j) {
+            const TraceEvent &event = buffer->events[j % TraceBuffer::CAPACITY];
+
+            stream << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                   << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+        }
+
+        count += written - begin;
+    }
+
+    stream << "\n]}\n";
+
+    qDebug() << QStringLiteral("Tracer: flushed") << count << QStringLiteral("events to '") + fileName + QStringLiteral("'.");
+
+    return true;
+}
+
+#endif // ENABLE_TRACING
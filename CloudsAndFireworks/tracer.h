@@ -0,0 +1,114 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#ifdef ENABLE_TRACING
+
+#include <QMutex>
+#include <QVector>
+#include <QString>
+#include <QElapsedTimer>
+#include <atomic>
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 duration;
+};
+
+/*!
+  @brief Буффер событий трассировки одного потока.
+
+  Пишет в него только поток-владелец, без блокировок. При переполнении старые события перезаписываются.
+  */
+
+
+struct TraceBuffer
+{
+    static const int CAPACITY = 65536;
+
+    TraceEvent events[CAPACITY];
+    std::atomic<quint64> written;
+    int threadId;
+    QString threadName;
+
+    TraceBuffer(int threadId, const QString &threadName)
+        : written(0)
+        , threadId(threadId)
+        , threadName(threadName) {}
+};
+
+/*!
+  @brief Класс трассировщика.
+
+  Собирает отрезки времени фаз кадра на CPU и сохраняет их в формате Chrome trace-event JSON.
+  */
+
+
+class Tracer
+{
+
+public:
+    /*! Возвращает единственный экземпляр трассировщика. */
+    static Tracer &instance();
+
+    /*! Возвращает время в наносекундах с момента запуска трассировщика. */
+    qint64 now() const;
+
+    /*!
+     * Записывает событие <i>name</i> с началом <i>start</i> и длительностью <i>duration</i> в буффер текущего потока.
+     * <i>name</i> должен быть строковым литералом.
+     */
+    void record(const char *name, qint64 start, qint64 duration);
+
+    /*!
+     * Сохраняет в файл <i>fileName</i> все события, которые ещё хранятся в буфферах, в том числе уже сохранённые раньше.
+     * Возвращает <i>true</i> при успешной записи.
+     */
+    bool flush(const QString &fileName);
+
+private:
+    Tracer();
+    ~Tracer();
+    TraceBuffer *threadBuffer();
+
+    QElapsedTimer m_timer;
+    QMutex m_mutex;
+    QVector<TraceBuffer*> m_buffers;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(name)
+        , m_start(Tracer::instance().now()) {}
+
+    ~TraceScope()
+    {
+        Tracer &tracer = Tracer::instance();
+        tracer.record(m_name, m_start, tracer.now() - m_start);
+    }
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_NOW() Tracer::instance().now()
+#define TRACE_COMPLETE(name, start) Tracer::instance().record(name, start, Tracer::instance().now() - (start))
+#define TRACE_FLUSH(fileName) Tracer::instance().flush(fileName)
+
+#else
+
+#define TRACE_SCOPE(name) (void)0
+#define TRACE_NOW() qint64(0)
+#define TRACE_COMPLETE(name, start) (void)0
+#define TRACE_FLUSH(fileName) (void)0
+
+#endif // ENABLE_TRACING
+
+#endif // TRACER_H
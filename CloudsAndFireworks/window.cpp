@@ -1,366 +1,236 @@
 #include "window.h"
 #include <QSurfaceFormat>
 #include <QMouseEvent>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QDateTime>
 
 Window::Window(uint width, uint height)
     : QOpenGLWidget()
-    , m_windowWidth(width)
-    , m_windowHeight(height)
-    , m_frameCount(0)
+    , m_profilerOverlayVisible(false)
+    , m_composeStart(0)
+    , m_inputLog(NULL)
+    , m_renderer(width, height)
 {
     setWindowTitle("Clouds and Fireworks");
-    setMinimumSize(width, height);
-    setMaximumSize(width, height);
+    resize(width, height);
+    setFocusPolicy(Qt::StrongFocus);
 
     qDebug() << this->format();
 
+#ifdef ENABLE_TRACING
+    connect(this, &QOpenGLWidget::aboutToCompose, [this]() { m_composeStart = TRACE_NOW(); });
+    connect(this, &QOpenGLWidget::frameSwapped, [this]() { TRACE_COMPLETE("Window::swapBuffers", m_composeStart); });
+#endif
+
     startTimer(17); 
 }
 
 Window::~Window()
 {
-    m_vao.destroy();
-    qDeleteAll(m_fbos);
-    qDeleteAll(m_cloudTextures);
+    makeCurrent();
 }
 
-void Window::initializeGL()
+Renderer &Window::renderer()
 {
-    initializeOpenGLFunctions();
-
-    glDisable(GL_DEPTH_TEST);
-
-    m_resourceManager.init();
-
-    m_vao.create();
-    m_vao.bind();
-
-    m_vertexBuffer = m_resourceManager.createVertexBuffer(4 * sizeof(VertexData));
-
-    m_resourceManager.bindVertexBuffer(m_vertexBuffer);
-
-    m_vertexData.clear();
-    m_vertexData << VertexData(QVector3D(0.0f, 0.0f, 0.0f), QVector2D(0.0f, 0.0f))
-                 << VertexData(QVector3D(1.0f, 0.0f, 0.0f), QVector2D(1.0f, 0.0f))
-                 << VertexData(QVector3D(0.0f, 1.0f, 0.0f), QVector2D(0.0f, 1.0f))
-                 << VertexData(QVector3D(1.0f, 1.0f, 0.0f), QVector2D(1.0f, 1.0f));
-
-    m_vertexBuffer->write(0, m_vertexData.data(), m_vertexData.size() * sizeof(VertexData));
+    return m_renderer;
+}
 
-    m_backgroundTexture = m_resourceManager.createTexture(":/images/background.png");
+void Window::setCaptureFile(const QString &fileName, CaptureFormats format)
+{
+    m_renderer.setCaptureFile(fileName, format);
 
-    QOpenGLTexture *cloudTexture;
+    // The frame size of the stream is written once in its header, the capture reads frames of exactly that size
+    setFixedSize(size());
+}
 
-    for(int i = 32; i < 1024; i *= 2) {
-        cloudTexture = new QOpenGLTexture(m_cloud.createCloud(i, 0.7, 0.05, 0.9));
-        cloudTexture->setWrapMode(QOpenGLTexture::MirroredRepeat);
-        m_cloudTextures << cloudTexture;
-    }
+void Window::setInputLog(InputLog *log)
+{
+    m_inputLog = log;
 
-    m_cloudProgram = m_resourceManager.createShaderProgram(":/shaders/clouds.frag", ":/shaders/default.vert");
+    // Launch positions are only reproducible in a frame of the recorded size
+    if(m_inputLog)
+        setFixedSize(size());
+}
 
-    m_circleParticleTexture = m_resourceManager.createTexture(":/images/circleParticle.png");
-    m_starParticleTexture = m_resourceManager.createTexture(":/images/starParticle.png");
+StressTest &Window::stressTest()
+{
+    return m_stressTest;
+}
 
-    QOpenGLFramebufferObjectFormat fboFormat;
-    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+ShowScheduler &Window::showScheduler()
+{
+    return m_showScheduler;
+}
 
-    for(uint i = 0; i < 2; ++i) {
-        m_fbos << new QOpenGLFramebufferObject(m_windowWidth, m_windowHeight, fboFormat);
-        m_fbos.last()->bind();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-        m_fbos.last()->release();
-    }
+LaunchServer &Window::launchServer()
+{
+    return m_launchServer;
+}
 
-    m_explosionTexture = m_resourceManager.createTexture(":/images/explosion.png");
+void Window::initializeGL()
+{
+    TRACE_SCOPE("Window::initializeGL");
 
-    m_fireworkProgram = m_resourceManager.createShaderProgram(":/shaders/fireworks.frag", ":/shaders/default.vert");
-    m_waterProgram = m_resourceManager.createShaderProgram(":/shaders/water.frag", ":/shaders/default.vert");
+    m_renderer.initialize();
 }
 
 void Window::paintGL()
 {
-    m_resourceManager.setupGLState();
-
-
-    m_fbos[0]->bind();
-
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-    drawBackground();
-
-    if(m_fireworks.size())
-        drawFireworks();
-
-    m_fbos[0]->release();
-
-
-    m_fbos[1]->bind();
-
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-    drawClouds();
-
-    m_fbos[1]->release();
-
-
-    m_resourceManager.bindDefaultShaderProgram();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fbos.at(0)->texture());
-    m_resourceManager.defaultShaderProgram()->setUniformValue("tex", 0);
-
-    m_matrixStack.push(Model);
-    m_matrixStack.model().translate(0.0f, m_windowHeight/6.0f);
-    m_matrixStack.model().scale(m_windowWidth, m_windowHeight/1.1667f);
+    TRACE_SCOPE("Window::paintGL");
 
-    m_resourceManager.defaultShaderProgram()->setUniformValue("colorMode", (uint)DefaultShaderModes::Texture);
-    m_resourceManager.defaultShaderProgram()->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+    // QOpenGLWidget binds its framebuffer and sets the viewport itself before every paintGL()
+    m_renderer.resourceManager().state().invalidateFramebuffers();
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-
-    m_matrixStack.pop(Model);
-
-    drawClouds();
-    drawWater();
+    m_renderer.render(defaultFramebufferObject());
 
+    if(m_profilerOverlayVisible)
+        drawProfilerOverlay();
 }
+
 void Window::resizeGL(int width, int height)
 {
-    if(width >= 0 && height >= 0) {
-        glViewport(0, 0, width, height);
-        m_matrixStack.projection().ortho(0.0f, width, 0.0f, height, -1.0f, 1.0f);
+    m_renderer.resize(width, height);
 
-        m_windowWidth = (uint)width;
-        m_windowHeight = (uint)height;
-    }
+    // The widget has just recreated its framebuffer object, which binds a texture and a framebuffer
+    m_renderer.resourceManager().state().invalidate();
+
+    // The widget renders into its own framebuffer object, which is composed into the window afterwards
+    qint64 pixels = qint64(width * devicePixelRatio()) * qint64(height * devicePixelRatio());
+    m_renderer.resourceManager().memory().registerAllocation(this, GpuMemoryCategories::Framebuffers, QStringLiteral("Window"),
+                                                             QStringLiteral("RGBA8+D24S8"), pixels * 8);
 }
 
 void Window::mousePressEvent(QMouseEvent *event)
 {
     if(event->button() == Qt::LeftButton) {
-        m_fireworks << Firework(event->pos().x(), m_windowHeight - event->pos().y() * 1.1667f - 28.0f);
+        if(m_inputLog)
+            m_inputLog->recordLaunch(m_renderer.renderedFrames(), event->pos());
+
+        m_renderer.launchFirework(event->pos());
     }
 
 }
 
-void Window::timerEvent(QTimerEvent */*event*/)
+void Window::keyPressEvent(QKeyEvent *event)
 {
-    ++m_frameCount;
-    repaint();
+    switch(event->key()) {
+    case Qt::Key_F1:
+        m_profilerOverlayVisible = !m_profilerOverlayVisible;
+        break;
+    case Qt::Key_F2:
+        m_renderer.resourceManager().profiler().exportCsv(QStringLiteral("profile-") + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + QStringLiteral(".csv"));
+        break;
+    case Qt::Key_F3:
+        TRACE_FLUSH(QStringLiteral("trace-") + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + QStringLiteral(".json"));
+        break;
+    case Qt::Key_F4:
+        m_renderer.resourceManager().memory().dump();
+        break;
+    case Qt::Key_F5:
+        // The mode is part of the recorded show and stays fixed while recording
+        if(m_inputLog && m_inputLog->isRecording())
+            break;
+
+        // Cycles CPU -> GPU -> closed-form trajectories
+        m_renderer.setSimulationMode((SimulationModes)(((int)m_renderer.simulationMode() + 1) % 3));
+        break;
+    default:
+        QOpenGLWidget::keyPressEvent(event);
+        break;
+    }
 }
 
-void Window::drawBackground()
+void Window::timerEvent(QTimerEvent */*event*/)
 {
-    m_resourceManager.bindDefaultShaderProgram();
-
-    m_matrixStack.push(Model);
-    m_matrixStack.model().scale(m_windowWidth, m_windowHeight);
-
-    m_resourceManager.bindTexture(m_backgroundTexture);
-    m_resourceManager.defaultShaderProgram()->setUniformValue("tex", 0);
-
-    m_resourceManager.defaultShaderProgram()->setUniformValue("colorMode", (uint)DefaultShaderModes::Texture);
-    m_resourceManager.defaultShaderProgram()->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-
-    m_matrixStack.pop(Model);
+    m_stressTest.update(m_renderer);
+    m_showScheduler.update(m_renderer);
+    m_launchServer.drain(m_renderer);
+    m_renderer.advanceFrame();
+    repaint();
 }
 
-void Window::drawClouds()
+void Window::drawProfilerOverlay()
 {
-    m_resourceManager.bindShaderProgram(m_cloudProgram);
-
-    m_matrixStack.push(Model);
-    m_matrixStack.model().translate(0.0f, m_windowHeight - m_windowHeight/1.7f);
-    m_matrixStack.model().scale(m_windowWidth, m_windowHeight/1.7f);
+    // QPainter expects the default state and changes it behind the resource manager's back
+    m_renderer.restoreGLState();
 
-    m_resourceManager.bindTexture(m_cloudTextures[0], GL_TEXTURE0);
-    m_cloudProgram->setUniformValue("tex1", 0);
-    m_resourceManager.bindTexture(m_cloudTextures[1], GL_TEXTURE1);
-    m_cloudProgram->setUniformValue("tex2", 1);
-    m_resourceManager.bindTexture(m_cloudTextures[2], GL_TEXTURE2);
-    m_cloudProgram->setUniformValue("tex3", 2);
-    m_resourceManager.bindTexture(m_cloudTextures[3], GL_TEXTURE3);
-    m_cloudProgram->setUniformValue("tex4", 3);
-    m_resourceManager.bindTexture(m_cloudTextures[4], GL_TEXTURE4);
-    m_cloudProgram->setUniformValue("tex5", 4);
+    FrameTimings timings = m_renderer.resourceManager().profiler().average();
 
-    m_cloudProgram->setUniformValue("offset", (float)m_frameCount/(float)m_windowWidth);
+    QFont font(QStringLiteral("Monospace"), 9);
+    font.setStyleHint(QFont::TypeWriter);
 
-    m_cloudProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+    QStringList lines;
+    lines << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Pass"), -12).arg(QStringLiteral("CPU ms"), 8).arg(QStringLiteral("GPU ms"), 8);
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-
-    m_matrixStack.pop(Model);
-}
-
-void Window::drawFireworks()
-{
-    m_resourceManager.bindShaderProgram(m_fireworkProgram);
-    m_fireworkProgram->setUniformValue("tex", 0);
-
-    GLfloat size, angle;
-    QVector2D position, velocity, offset;
-    GLColor color;
-    QVector<Particle> particle;
-    FireworkTypes type;
-
-    for (int i = 0; i < m_fireworks.size(); ++i) {
-
-        m_resourceManager.bindTexture(m_circleParticleTexture);
-        size = m_fireworks.at(i).getRocketSize();
-        for (uint j = 0; j < m_fireworks.at(i).getRocketParticlesQuantity(); ++j) {
-
-            position = m_fireworks.at(i).getRocketPosition(j);
-            color = m_fireworks.at(i).getRocketColor(j);
-
-            m_matrixStack.push(Model);
-            m_matrixStack.model().translate(position.x(), position.y());
-            m_matrixStack.model().scale(size / 2.0f, size * 2.0f);
-
-            m_fireworkProgram->setUniformValue("mode", (uint)FireworkModes::Snakes);
-            m_fireworkProgram->setUniformValue("solidColor", color.red, color.green, color.blue, color.alpha);
-            m_fireworkProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-            m_matrixStack.pop(Model);
-        }
-
-        if(m_fireworks.at(i).getParticlesQuantity() && !(m_fireworks.at(i).isExplosionFinished())) {
-
-            m_resourceManager.bindTexture(m_explosionTexture);
-
-            position = m_fireworks.at(i).getExplosionPosition();
-            offset = m_fireworks.at(i).calculateSpriteOffset();
-
-            m_matrixStack.push(Model);
-            m_matrixStack.model().translate(position.x(), position.y());
-            m_matrixStack.model().scale(70.0f, 70.0f);
-            m_matrixStack.model().translate(-0.5f, -0.5f);
-
-            m_fireworkProgram->setUniformValue("mode", (uint)FireworkModes::Explosion);
-            m_fireworkProgram->setUniformValue("spriteOffset", offset);
-            m_fireworkProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-
-            m_matrixStack.pop(Model);
-        }
-
-        m_resourceManager.bindTexture(m_starParticleTexture);
-
-        size = m_fireworks.at(i).getParticlesSize();
-        type = m_fireworks.at(i).getType();
-        for (uint j = 0; j < m_fireworks.at(i).getParticlesQuantity(); ++j) {
-
-            particle = m_fireworks[i].getParticle(j);
-            for (int k = 0; k < particle.size(); ++k) {
-
-                position = particle.at(k).getPosition();
-                velocity = particle.at(k).getVelocity();
-                color = particle.at(k).getColor();
-
-                if(type != FireworkTypes::Blinks) {
-                    angle = calculateRotationAngle(velocity, QVector2D(0.0f, 1.0f));
-                    m_fireworkProgram->setUniformValue("mode", (uint)FireworkModes::Snakes);
-                }
-                else {
-                    angle = 0.0f;
-                    m_fireworkProgram->setUniformValue("mode", (uint)FireworkModes::Blinks);
-                }
-
-                m_matrixStack.push(Model);
-                m_matrixStack.model().translate(position.x(), position.y());
-                m_matrixStack.model().scale(size, size);
-                m_matrixStack.model().rotate(angle, 0.0f, 0.0f, 1.0f);
-                m_matrixStack.model().translate(-0.5f, -0.5f);
-
-                m_fireworkProgram->setUniformValue("solidColor", color.red, color.green, color.blue, color.alpha);
-                m_fireworkProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
-                m_matrixStack.pop(Model);
-            }
-        }
-
-        switch(m_fireworks.at(i).getCurrentFireworkState()) {
-        case FireworkStates::Launched:
-            m_fireworks[i].moveRocket();
-            break;
-        case FireworkStates::Exploded:
-            m_fireworks[i].destroyRocketTail();
-            m_fireworks[i].moveFireworkParticles();
-            break;
-        case FireworkStates::Faded:
-            m_fireworks[i].destroyParticlesTails();
-            break;
-        case FireworkStates::Finished:
-            m_fireworks.removeAt(i);
-            break;
-        }
+    for(int i = 0; i < (int)ProfilerPasses::Count; ++i) {
+        lines << QStringLiteral("%1 %2 %3").arg(FrameProfiler::passName((ProfilerPasses)i), -12)
+                                           .arg(timings.passes[i].cpuMs, 8, 'f', 3)
+                                           .arg(timings.passes[i].gpuMs, 8, 'f', 3);
     }
-}
 
-void Window::drawWater()
-{
-    m_resourceManager.bindShaderProgram(m_waterProgram);
+    lines << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Frame"), -12)
+                                       .arg(timings.cpuFrameMs, 8, 'f', 3)
+                                       .arg(timings.gpuFrameMs, 8, 'f', 3);
+    lines << QStringLiteral("Dropped GPU timings: %1").arg(m_renderer.resourceManager().profiler().droppedFrames());
+    lines << QStringLiteral("Fireworks: %1").arg(m_renderer.fireworksCount());
+    lines << QStringLiteral("Render scale: %1%").arg(qRound(m_renderer.resolutionScaler().scale() * 100.0f));
+    lines << QStringLiteral("Simulation: %1, %2 GPU particles").arg(Renderer::simulationModeName(m_renderer.simulationMode()))
+                                                               .arg(m_renderer.gpuParticlesCount());
+    lines << QStringLiteral("Particles: %1 / %2").arg(m_renderer.particleBudget().live()).arg(m_renderer.particleBudget().budget());
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fbos.at(0)->texture());
-    m_resourceManager.defaultShaderProgram()->setUniformValue("tex", 0);
+    if(m_showScheduler.isPlaying())
+        lines << QStringLiteral("Show: frame %1 / %2, %3 launched").arg(m_showScheduler.frame()).arg(m_showScheduler.frames()).arg(m_showScheduler.launched());
 
-    m_waterProgram->setUniformValue("angle", (float)m_frameCount * 5.0f);
+    if(m_launchServer.isRunning())
+        lines << QStringLiteral("Remote: %1 launches, %2 stalls").arg(m_launchServer.stats().commands.load())
+                                                                 .arg(m_launchServer.stats().stalls.load());
 
-    m_matrixStack.push(Model);
-    m_matrixStack.model().translate(0.0f, m_windowHeight/6.0f);
-    m_matrixStack.model().scale(m_windowWidth, m_windowHeight/6.0f);
-    m_matrixStack.model().scale(1.0f, -1.0f);
+    if(m_stressTest.isRunning())
+        lines << QStringLiteral("Stress: %1 launches/s").arg(m_stressTest.launchRate(), 0, 'f', 1);
+    else if(m_stressTest.isFinished())
+        lines << QStringLiteral("Stress: %1 fireworks at %2/s").arg(m_stressTest.sustainedFireworks()).arg(m_stressTest.sustainedRate(), 0, 'f', 1);
 
-    m_waterProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+    const GLStateCounters &stateCalls = m_renderer.resourceManager().state().lastFrame();
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+    lines << QStringLiteral("%1 %2 %3").arg(QStringLiteral("GL state"), -12).arg(QStringLiteral("issued"), 8).arg(QStringLiteral("skipped"), 8);
 
+    for(int i = 0; i < (int)GLStateCalls::Count; ++i) {
+        lines << QStringLiteral("%1 %2 %3").arg(GLStateCache::callName((GLStateCalls)i), -12)
+                                           .arg(stateCalls.issued[i], 8)
+                                           .arg(stateCalls.skipped[i], 8);
+    }
 
-    m_matrixStack.pop(Model);
+    const GpuMemoryTracker &memory = m_renderer.resourceManager().memory();
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fbos.at(1)->texture());
-    m_matrixStack.push(Model);
-    m_matrixStack.model().translate(0.0f, m_windowHeight/3.0f);
-    m_matrixStack.model().scale(m_windowWidth, m_windowHeight/3.0f);
-    m_matrixStack.model().scale(1.0f, -1.0f);
+    lines << QStringLiteral("%1 %2 %3").arg(QStringLiteral("VRAM MiB"), -12).arg(QStringLiteral("now"), 8).arg(QStringLiteral("peak"), 8);
 
-    m_waterProgram->setUniformValue("modelViewProjectionMatrix", m_matrixStack.getCopy(ModelViewProjection));
+    for(int i = 0; i < (int)GpuMemoryCategories::Count; ++i) {
+        lines << QStringLiteral("%1 %2 %3").arg(GpuMemoryTracker::categoryName((GpuMemoryCategories)i), -12)
+                                           .arg(memory.total((GpuMemoryCategories)i) / 1048576.0, 8, 'f', 2)
+                                           .arg(memory.peak((GpuMemoryCategories)i) / 1048576.0, 8, 'f', 2);
+    }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexData.size());
+    lines << QStringLiteral("%1 %2 %3").arg(QStringLiteral("Total"), -12)
+                                       .arg(memory.total() / 1048576.0, 8, 'f', 2)
+                                       .arg(memory.peak() / 1048576.0, 8, 'f', 2);
 
-    m_matrixStack.pop(Model);
-}
+    if(memory.budget() > 0)
+        lines << QStringLiteral("Budget: %1 MiB").arg(memory.budget() / 1048576.0, 0, 'f', 0);
 
-GLfloat Window::calculateRotationAngle(QVector2D vector1, QVector2D vector2)
-{
-    GLfloat angle = 0.0f;
+    lines << QStringLiteral("F2 - export CSV, F5 - simulation mode");
 
-    if(!vector1.length() || !vector2.length())
-        return 0.0f;
+    QPainter painter(this);
+    painter.setFont(font);
 
-    float cos = QVector2D::dotProduct(vector1, vector2)/(vector1.length() * vector2.length());
-    fixBoundary(-1.0f, cos, 1.0f);
-    angle = acos(cos) * 180.0 / M_PI;
+    int lineHeight = painter.fontMetrics().height();
+    painter.fillRect(8, 8, 300, lineHeight * lines.size() + 8, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
 
-    if(vector1.x() > 0)
-        angle = -angle;
+    for(int i = 0; i < lines.size(); ++i)
+        painter.drawText(12, 12 + lineHeight * i + painter.fontMetrics().ascent(), lines.at(i));
 
-    return angle;
-}
+    painter.end();
 
-float Window::fixBoundary(const float &min, float &value, const float &max)
-{
-    if (value < min) {
-        value = min;
-    } else if (value > max) {
-        value = max;
-    }
-    return value;
+    m_renderer.resourceManager().state().invalidate();
 }
-
@@ -2,15 +2,15 @@
 #define WINDOW_H
 
 #include <QOpenGLWidget>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLFramebufferObject>
 #include <QElapsedTimer>
-#include "resourcemanager.h"
-#include "glmatrixstack.h"
-#include "cloud.h"
-#include "firework.h"
-
-class Window : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
+#include "renderer.h"
+#include "inputlog.h"
+#include "stresstest.h"
+#include "showscheduler.h"
+#include "launchserver.h"
+#include "tracer.h"
+
+class Window : public QOpenGLWidget
 {
     Q_OBJECT
 
@@ -18,45 +18,40 @@ public:
     explicit Window(uint width = 1280, uint height = 800);
     ~Window();
 
-private:
-    void initializeGL() Q_DECL_OVERRIDE;
-    void paintGL() Q_DECL_OVERRIDE;
-    void resizeGL(int width, int height) Q_DECL_OVERRIDE;
-    void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
-    void timerEvent(QTimerEvent *) Q_DECL_OVERRIDE;
-    void drawBackground();
-    void drawClouds();
-    void drawFireworks();
-    void drawWater();
-    GLfloat calculateRotationAngle(QVector2D vector1, QVector2D vector2);
-    float fixBoundary(const float &min, float &value, const float &max);
+    Renderer &renderer();
 
-    uint m_windowWidth;
-    uint m_windowHeight;
-    uint m_frameCount;
+    /*! Включает запись кадров в файл <i>fileName</i>, см. Renderer::setCaptureFile(). Размер окна при этом фиксируется. */
+    void setCaptureFile(const QString &fileName, CaptureFormats format);
 
-    ResourceManager m_resourceManager;
-    QOpenGLShaderProgram *m_cloudProgram;
-    QOpenGLShaderProgram *m_fireworkProgram;
-    QOpenGLShaderProgram *m_waterProgram;
+    /*! Записывает запуски в журнал <i>log</i>, который уже начал запись. Размер окна при этом фиксируется. */
+    void setInputLog(InputLog *log);
 
-    QOpenGLTexture *m_backgroundTexture;
-    QVector<QOpenGLTexture*> m_cloudTextures;
-    QOpenGLTexture *m_circleParticleTexture;
-    QOpenGLTexture *m_starParticleTexture;
-    QOpenGLTexture *m_explosionTexture;
+    /*! Возвращает нагрузочный тест, который запускает фейерверки вместо мыши. */
+    StressTest &stressTest();
 
-    QOpenGLVertexArrayObject m_vao;
-    QVector<VertexData> m_vertexData;
-    QOpenGLBuffer *m_vertexBuffer;
+    /*! Возвращает планировщик шоу, который запускает фейерверки по файлу шоу. */
+    ShowScheduler &showScheduler();
 
-    GLMatrixStack m_matrixStack;
+    /*! Возвращает сервер, принимающий запуски от внешнего пульта. */
+    LaunchServer &launchServer();
 
-    Cloud m_cloud;
+private:
+    void initializeGL() Q_DECL_OVERRIDE;
+    void paintGL() Q_DECL_OVERRIDE;
+    void resizeGL(int width, int height) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+    void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
+    void timerEvent(QTimerEvent *) Q_DECL_OVERRIDE;
+    void drawProfilerOverlay();
 
-    QVector<Firework> m_fireworks;
+    bool m_profilerOverlayVisible;
+    qint64 m_composeStart;
+    InputLog *m_inputLog;
+    StressTest m_stressTest;
+    ShowScheduler m_showScheduler;
+    LaunchServer m_launchServer;
 
-    QVector<QOpenGLFramebufferObject*> m_fbos;
+    Renderer m_renderer;
 };
 
 #endif // WINDOW_H